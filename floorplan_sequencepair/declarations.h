@@ -1,5 +1,6 @@
 #include <iostream>
 #include <vector>
+#include <array>
 #include <sstream>
 #include <fstream>
 #include <filesystem>
@@ -9,13 +10,27 @@
 #include <algorithm>
 #include <queue>
 #include <climits>
+#include <limits>
 #include <omp.h>
+#include <chrono>
+#include <numeric>
+#include <cmath>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 namespace fp {
 
+  class Floorplan;
   class SP;
+  class BStarTree;
+  class Slicing;
   class Block;
   class Net;
-  class ParallelSP;
+  class Terminal;
+  template <typename T> class Parallel;
 
 }
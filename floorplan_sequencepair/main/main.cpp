@@ -1,12 +1,14 @@
 #include  <src/sp.hpp>
+#include  <src/bstar_tree.hpp>
+#include  <src/slicing.hpp>
 #include  <src/parallel_sp.hpp>
 #include <iostream>
 
 
 int main(int argc, char** argv) {
 
-  if(argc != 6) {
-    throw std::runtime_error("Number of parameters should be exact 5!\n ./sp alpha input_block_file input_net_file output_file num_threads");
+  if(argc < 6) {
+    throw std::runtime_error("Number of parameters should be at least 5!\n ./sp alpha input_block_file input_net_file output_file num_threads [--engine sp|btree|slicing] [--tempering | --sharing] [--adaptive] [--seed n]");
   }
   float alpha = std::stof(argv[1]);
   std::string blockf = argv[2];
@@ -14,8 +16,62 @@ int main(int argc, char** argv) {
   std::ofstream output_file{argv[4]};
   size_t num_threads = std::stoi(argv[5]);
 
-  fp::ParallelSP algo(alpha, blockf, netf, num_threads);
-  algo.apply();
-  algo.dump(output_file);
+  std::string engine{"sp"};
+  bool tempering{false};
+  bool sharing{false};
+  bool adaptive{false};
+  std::mt19937::result_type seed = std::random_device{}();
+  for(int i = 6; i < argc; ++i) {
+    std::string arg = argv[i];
+    if(arg == "--engine" && i + 1 < argc) {
+      engine = argv[++i];
+    }
+    else if(arg == "--tempering") {
+      tempering = true;
+    }
+    else if(arg == "--sharing") {
+      sharing = true;
+    }
+    else if(arg == "--adaptive") {
+      adaptive = true;
+    }
+    else if(arg == "--seed" && i + 1 < argc) {
+      seed = std::stoul(argv[++i]);
+    }
+    else {
+      throw std::runtime_error("unknown option " + arg);
+    }
+  }
+
+  if(tempering && sharing) {
+    throw std::runtime_error("--tempering and --sharing cannot be combined");
+  }
+
+  // a slicing floorplan held at one temperature rarely settles into the
+  // outline; it needs the cooling of the restart rounds
+  if(tempering && engine == "slicing") {
+    throw std::runtime_error("--tempering does not support --engine slicing");
+  }
+
+  auto run = [&](auto&& algo) {
+    algo.set_tempering(tempering);
+    algo.set_sharing(sharing);
+    algo.set_adaptive(adaptive);
+    algo.apply();
+    algo.dump(output_file);
+  };
+
+  if(engine == "sp") {
+    run(fp::ParallelSP(alpha, blockf, netf, num_threads, seed));
+  }
+  else if(engine == "btree") {
+    run(fp::ParallelBStarTree(alpha, blockf, netf, num_threads, seed));
+  }
+  else if(engine == "slicing") {
+    run(fp::ParallelSlicing(alpha, blockf, netf, num_threads, seed));
+  }
+  else {
+    throw std::runtime_error("unknown engine " + engine + ", expected sp, btree or slicing");
+  }
   
 }
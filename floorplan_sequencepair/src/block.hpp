@@ -5,14 +5,15 @@ namespace fp { // begin of namespace ====================================
 
 
 class Block {
+  friend class Floorplan;
   friend class SP;
+  friend class BStarTree;
+  friend class Slicing;
 
   public:
     Block(
       const std::string& name,
-      const size_t id,
-      const size_t height,
-      const size_t width
+      const size_t id
     );
 
     Block(const Block& bk) = default;
@@ -23,26 +24,14 @@ class Block {
   
     ~Block() = default;
 
-    void set_coordinate(
-      size_t x1,
-      size_t y1,
-      size_t x2,
-      size_t y2
-    );
-
   private:
 
+    // the size and position of block _id are kept by its Floorplan, in
+    // arrays indexed by id
     std::vector<Block*> _hconnects;
     std::vector<Block*> _vconnects;
     std::string _name;
     size_t _id;
-    size_t _height;
-    size_t _width;
-
-    size_t _x1;
-    size_t _y1;
-    size_t _x2;
-    size_t _y2;
     bool _locked{false};
 
     
@@ -50,22 +39,8 @@ class Block {
 
 Block::Block(
   const std::string& name,
-  const size_t id,
-  const size_t height,
-  const size_t width
-):_name{name}, _id{id}, _height{height}, _width{width} {
-}
-
-void Block::set_coordinate(
-  size_t x1,
-  size_t y1,
-  size_t x2,
-  size_t y2
-) {
-  _x1 = x1;
-  _y1 = y1;
-  _x2 = x2;
-  _y2 = y2;
+  const size_t id
+):_name{name}, _id{id} {
 }
 
 
@@ -0,0 +1,362 @@
+#pragma once
+#include <declarations.h>
+#include <src/utility.hpp>
+#include <src/block.hpp>
+#include <src/terminal.hpp>
+#include <src/net.hpp>
+#include <src/floorplan.hpp>
+
+namespace fp { // begin of namespace ====================================
+
+// B*-tree floorplan (Chang et al., DAC 2000): the left child of a node is
+// placed right next to it, the right child right above it at the same x,
+// and every block drops onto the contour of the blocks placed before it in
+// DFS order. Packing is O(n) amortized.
+class BStarTree : public Floorplan {
+
+  template <typename T> friend class Parallel;
+
+  public:
+
+    static constexpr const char* title{"B*-tree Placement"};
+
+    BStarTree(
+      const float alpha,
+      const std::filesystem::path& blockf,
+      const std::filesystem::path& netf,
+      std::mt19937 eng
+    );
+
+    BStarTree(const BStarTree& bt) = default;
+    BStarTree(BStarTree&& bt) = default;
+
+    BStarTree& operator= (const BStarTree& bt) = default;
+    BStarTree& operator= (BStarTree&& bt) = default;
+
+    ~BStarTree() = default;
+
+  private:
+
+    // nodes of the tree are slots; a swap only exchanges the blocks of two
+    // slots, a move unlinks one slot and links it again elsewhere
+    struct Tree {
+      std::vector<size_t> parent;
+      std::vector<size_t> left;
+      std::vector<size_t> right;
+      std::vector<size_t> block;
+      std::vector<size_t> slot;
+      size_t root;
+    };
+
+    static constexpr size_t _nil{SIZE_MAX};
+
+    void _initialize();
+    void _pack();
+    void _place(size_t id, size_t x1, size_t c);
+    void _move();
+    void _rotate(size_t id);
+    void _swap(size_t id1, size_t id2);
+    void _delete(size_t id);
+    void _insert(size_t id, size_t s, bool left);
+    void _get_results();
+    void _reject();
+    void _accept();
+    void _update_best();
+    void _update_all_to_best();
+    void _adopt_best(const BStarTree& bt);
+
+    // the best solution, never changed once taken
+    struct Snapshot {
+      Tree tree;
+      std::vector<uint32_t> width;
+      std::vector<uint32_t> height;
+      double cost;
+    };
+
+    Snapshot _snapshot() const;
+    void _adopt(const Snapshot& snapshot);
+
+    Tree _tree;
+    Tree _prev_tree;
+    Tree _best_tree;
+    double _prev_cost;
+    double _best_cost;
+
+    std::vector<uint32_t> _best_width;
+    std::vector<uint32_t> _best_height;
+    std::vector<uint32_t> _prev_width;
+    std::vector<uint32_t> _prev_height;
+
+    // contour as a list of blocks ordered by x, between src (head) and tgt
+    // (tail); the segment of a block starts where its predecessor ends
+    std::vector<size_t> _contour_next;
+    std::vector<size_t> _contour_prev;
+    std::vector<size_t> _stack;
+};
+
+BStarTree::BStarTree(
+  const float alpha,
+  const std::filesystem::path& blockf,
+  const std::filesystem::path& netf,
+  std::mt19937 eng
+): Floorplan(alpha, blockf, netf, std::move(eng)) {
+
+  _contour_next.resize(_blocks.size());
+  _contour_prev.resize(_blocks.size());
+
+  _initialize();
+  _update_average();
+
+  _cost = INT_MAX;
+  _update_best();
+  _update_all_to_best();
+}
+
+// a random complete binary tree over a shuffled block order
+void BStarTree::_initialize() {
+  _tree.parent.assign(_num_blocks, _nil);
+  _tree.left.assign(_num_blocks, _nil);
+  _tree.right.assign(_num_blocks, _nil);
+  _tree.block.resize(_num_blocks);
+  _tree.slot.assign(_num_blocks + 2, _nil);
+  _tree.root = 0;
+
+  std::iota(_tree.block.begin(), _tree.block.end(), 2);
+  std::shuffle(_tree.block.begin(), _tree.block.end(), _eng);
+
+  for(size_t s = 0; s < _num_blocks; ++s) {
+    _tree.slot[_tree.block[s]] = s;
+    if(2 * s + 1 < _num_blocks) {
+      _tree.left[s] = 2 * s + 1;
+      _tree.parent[2 * s + 1] = s;
+    }
+    if(2 * s + 2 < _num_blocks) {
+      _tree.right[s] = 2 * s + 2;
+      _tree.parent[2 * s + 2] = s;
+    }
+  }
+
+  _get_results();
+}
+
+void BStarTree::_get_results() {
+  _pack();
+
+  _chip_width = max_u32(_x2.data() + 2, _num_blocks);
+  _chip_height = max_u32(_y2.data() + 2, _num_blocks);
+  _chip_area = _chip_height * _chip_width;
+
+  _set_wirelength();
+}
+
+// preorder DFS: a left child starts at the right edge of its parent, right
+// after it on the contour; a right child starts at the left edge of its
+// parent, whose contour segment the left subtree (all further right) never
+// covers
+void BStarTree::_pack() {
+  _contour_next[0] = 1;
+  _contour_prev[1] = 0;
+
+  _stack.clear();
+  _stack.push_back(_tree.root);
+  while(!_stack.empty()) {
+    auto s = _stack.back();
+    _stack.pop_back();
+
+    auto id = _tree.block[s];
+    auto p = _tree.parent[s];
+    if(p == _nil) {
+      _place(id, 0, _contour_next[0]);
+    }
+    else {
+      auto pid = _tree.block[p];
+      if(_tree.left[p] == s) {
+        _place(id, _x2[pid], _contour_next[pid]);
+      }
+      else {
+        _place(id, _x1[pid], pid);
+      }
+    }
+
+    if(_tree.right[s] != _nil) {
+      _stack.push_back(_tree.right[s]);
+    }
+    if(_tree.left[s] != _nil) {
+      _stack.push_back(_tree.left[s]);
+    }
+  }
+}
+
+// drops block id at x1 onto the contour starting at node c, the node whose
+// segment begins at x1 (or the tail)
+void BStarTree::_place(size_t id, size_t x1, size_t c) {
+  auto x2 = x1 + _width[id];
+  auto p = _contour_prev[c];
+
+  uint32_t y1{0};
+  while(c != 1) {
+    auto cx2 = _x2[c];
+    y1 = std::max(y1, _y2[c]);
+    if(cx2 > x2) {
+      break;
+    }
+    c = _contour_next[c];
+    if(cx2 == x2) {
+      break;
+    }
+  }
+
+  _contour_next[p] = id;
+  _contour_prev[id] = p;
+  _contour_next[id] = c;
+  _contour_prev[c] = id;
+
+  _locate(id, x1, y1);
+}
+
+// op1 rotates a block, op2 moves a block to another place in the tree and
+// op3 swaps two blocks
+void BStarTree::_move() {
+
+  std::uniform_int_distribution<> random_move(1, 3);
+  std::uniform_int_distribution<size_t> random_idx(2, _num_blocks + 1);
+  std::bernoulli_distribution random_side;
+
+  switch(_num_blocks < 2 ? 1 : random_move(_eng)) {
+    case 1: {
+      _rotate(random_idx(_eng));
+      break;
+    }
+    case 2: {
+      auto id = random_idx(_eng);
+      _delete(id);
+
+      // any other slot still in the tree
+      std::uniform_int_distribution<size_t> random_slot(0, _num_blocks - 2);
+      auto s = random_slot(_eng);
+      if(s >= _tree.slot[id]) {
+        ++s;
+      }
+      _insert(id, s, random_side(_eng));
+      break;
+    }
+    default: {
+      auto id1 = random_idx(_eng);
+      auto id2 = random_idx(_eng);
+      _swap(id1, id2);
+      break;
+    }
+  }
+}
+
+void BStarTree::_rotate(size_t id) {
+  std::swap(_width[id], _height[id]);
+}
+
+void BStarTree::_swap(size_t id1, size_t id2) {
+  auto s1 = _tree.slot[id1];
+  auto s2 = _tree.slot[id2];
+  std::swap(_tree.block[s1], _tree.block[s2]);
+  std::swap(_tree.slot[id1], _tree.slot[id2]);
+}
+
+// the block sinks into a child slot until its slot has at most one child,
+// then that slot is spliced out
+void BStarTree::_delete(size_t id) {
+  std::bernoulli_distribution random_side;
+
+  auto s = _tree.slot[id];
+  while(_tree.left[s] != _nil && _tree.right[s] != _nil) {
+    auto c = random_side(_eng) ? _tree.left[s] : _tree.right[s];
+    _swap(id, _tree.block[c]);
+    s = c;
+  }
+
+  auto c = _tree.left[s] != _nil ? _tree.left[s] : _tree.right[s];
+  auto p = _tree.parent[s];
+  if(c != _nil) {
+    _tree.parent[c] = p;
+  }
+  if(p == _nil) {
+    _tree.root = c;
+  }
+  else if(_tree.left[p] == s) {
+    _tree.left[p] = c;
+  }
+  else {
+    _tree.right[p] = c;
+  }
+
+  _tree.parent[s] = _nil;
+  _tree.left[s] = _nil;
+  _tree.right[s] = _nil;
+}
+
+// the slot of block id becomes the left or right child of slot s and takes
+// over the child it replaces on the same side
+void BStarTree::_insert(size_t id, size_t s, bool left) {
+  auto n = _tree.slot[id];
+  auto& child = left ? _tree.left[s] : _tree.right[s];
+
+  if(child != _nil) {
+    _tree.parent[child] = n;
+  }
+  (left ? _tree.left[n] : _tree.right[n]) = child;
+  child = n;
+  _tree.parent[n] = s;
+}
+
+void BStarTree::_accept() {
+  _prev_tree = _tree;
+  _prev_cost = _cost;
+  _prev_width = _width;
+  _prev_height = _height;
+}
+
+void BStarTree::_reject() {
+  _tree = _prev_tree;
+  _cost = _prev_cost;
+  _width = _prev_width;
+  _height = _prev_height;
+}
+
+void BStarTree::_update_best() {
+  _best_tree = _tree;
+  _best_cost = _cost;
+  _best_width = _width;
+  _best_height = _height;
+}
+
+void BStarTree::_update_all_to_best() {
+  _tree = _best_tree;
+  _cost = _best_cost;
+
+  _prev_tree = _best_tree;
+  _prev_cost = _best_cost;
+
+  _width = _best_width;
+  _height = _best_height;
+  _prev_width = _best_width;
+  _prev_height = _best_height;
+}
+
+// restart from the best solution of another annealer
+void BStarTree::_adopt_best(const BStarTree& bt) {
+  _adopt(bt._snapshot());
+}
+
+BStarTree::Snapshot BStarTree::_snapshot() const {
+  return {_best_tree, _best_width, _best_height, _best_cost};
+}
+
+void BStarTree::_adopt(const Snapshot& snapshot) {
+  _best_tree = snapshot.tree;
+  _best_width = snapshot.width;
+  _best_height = snapshot.height;
+  _best_cost = snapshot.cost;
+  _cost = snapshot.cost;
+
+  _update_all_to_best();
+}
+
+} // end of namespace ===================================================
@@ -0,0 +1,736 @@
+#pragma once
+#include <declarations.h>
+#include <src/utility.hpp>
+#include <src/block.hpp>
+#include <src/terminal.hpp>
+#include <src/net.hpp>
+#include <src/kernels.hpp>
+
+namespace fp { // begin of namespace ====================================
+
+// blocks, terminals and nets of a floorplanning problem and the output every
+// engine shares; the engines (SP, BStarTree) only own their representation
+class Floorplan {
+
+  template <typename T> friend class Parallel;
+
+  public:
+
+    Floorplan(
+      const float alpha,
+      const std::filesystem::path& blockf, 
+      const std::filesystem::path& netf,
+      std::mt19937 eng
+    );
+
+    Floorplan(const Floorplan& fp) = default;
+    Floorplan(Floorplan&& fp) = default;
+
+    Floorplan& operator= (const Floorplan& fp) = default;
+    Floorplan& operator= (Floorplan&& fp) = default;
+  
+    ~Floorplan() = default;
+
+    void dump(std::ostream& os);
+
+  protected:
+
+    void _parse_block(
+      const std::filesystem::path& blockf
+    );
+
+    void _parse_net(
+      const std::filesystem::path& netf
+    );
+
+    // bounding box of the doubled centers (x1 + x2, y1 + y2) of the pins of a
+    // net, exact in integers
+    struct Box {
+      uint32_t x_min{UINT32_MAX};
+      uint32_t x_max{0};
+      uint32_t y_min{UINT32_MAX};
+      uint32_t y_max{0};
+    };
+
+    void _update_average();
+    double _get_penalty();
+    void _set_wirelength();
+    void _set_wirelength(const std::vector<size_t>& moved);
+    void _sweep_wirelength();
+    void _move_pin(size_t id);
+    void _update_nets();
+    Box _net_box(size_t n) const;
+    static size_t _length2(const Box& box);
+    void _locate(size_t id, uint32_t x1, uint32_t y1);
+    void _compact();
+    bool _slide(
+      std::vector<uint32_t>& lo,
+      std::vector<uint32_t>& hi,
+      const std::vector<uint32_t>& cross_lo,
+      const std::vector<uint32_t>& cross_hi
+    );
+    bool _is_overlapped(size_t id) const;
+
+    std::unordered_map<std::string, Block> _blocks_map;
+    std::vector<Block*> _blocks;
+
+    // size and position of every block by id, contiguous for the scans of
+    // src/kernels.hpp
+    std::vector<uint32_t> _width;
+    std::vector<uint32_t> _height;
+    std::vector<uint32_t> _x1;
+    std::vector<uint32_t> _y1;
+    std::vector<uint32_t> _x2;
+    std::vector<uint32_t> _y2;
+
+    std::unordered_map<std::string, Terminal> _terminals_map;
+    std::vector<Net> _nets;
+
+    std::pair<size_t, size_t> _outline;
+    size_t _num_blocks;
+    size_t _num_nets;
+    size_t _num_terminals;
+
+    double _cost;
+
+    Block* _s;
+    Block* _t;
+
+    float _wire_length;
+    float _chip_area;
+    float _chip_height;
+    float _chip_width;
+    float _alpha;
+
+    size_t _iter{1};
+
+    double _area_average{0};
+    double _wire_length_average{0};
+    double _penalty_average{0};
+
+    // nets of every block by block id, the fixed box of the terminals of
+    // every net, and the box and doubled length of every net with the block
+    // centers they were last updated with
+    std::vector<std::vector<size_t>> _block_nets;
+    std::vector<size_t> _net_pins;
+    std::vector<size_t> _net_pin_begin;
+    std::vector<Box> _terminal_boxes;
+    std::vector<Box> _net_boxes;
+    std::vector<size_t> _net_length2;
+    std::vector<uint32_t> _cx;
+    std::vector<uint32_t> _cy;
+    size_t _num_pins{0};
+
+    // nets with a moved pin since the last update, and those whose box must
+    // be rebuilt from their pins
+    std::vector<size_t> _dirty_nets;
+    std::vector<char> _is_dirty;
+    std::vector<char> _is_stale;
+    std::vector<size_t> _shifted;
+
+    // twice the total HPWL, kept exact so incremental and full sums agree
+    size_t _wire_length2{0};
+
+    // moves accepted, and number and total cost increase of the moves that
+    // did not improve, since the schedule last reset them
+    size_t _num_accepted{0};
+    size_t _num_uphill{0};
+    double _uphill{0};
+
+    // own random stream, never shared with another annealer
+    std::mt19937 _eng;
+    std::chrono::time_point<std::chrono::steady_clock> _tic;
+    std::chrono::time_point<std::chrono::steady_clock> _toc;
+    float _runtime;
+
+};
+
+Floorplan::Floorplan(
+  const float alpha,
+  const std::filesystem::path& blockf, 
+  const std::filesystem::path& netf,
+  std::mt19937 eng
+):_alpha{alpha}, _eng{std::move(eng)} {
+  _tic = std::chrono::steady_clock::now();
+  // source
+  auto src = _blocks_map.emplace(
+    std::piecewise_construct, 
+    std::forward_as_tuple("src"), 
+    std::forward_as_tuple("src", 0)
+  );
+  auto& src_ = (*(src.first)).second;
+  _blocks.push_back(&src_);
+  _s = _blocks[0];
+
+  // target
+  auto tgt = _blocks_map.emplace(
+    std::piecewise_construct, 
+    std::forward_as_tuple("tgt"),
+    std::forward_as_tuple("tgt", 1)
+  );
+  auto& tgt_ = (*(tgt.first)).second;
+  _blocks.push_back(&tgt_);
+  _t = _blocks[1];
+  _width.assign(2, 0);
+  _height.assign(2, 0);
+
+  _parse_block(blockf);
+  _parse_net(netf);
+
+  // doubled centers and the signed compares of the kernels need every
+  // coordinate below 2^31, even with all blocks in a row
+  uint64_t extent{0};
+  for(size_t i = 2; i < _blocks.size(); ++i) {
+    extent += std::max(_width[i], _height[i]);
+  }
+  if(2 * std::max<uint64_t>({extent, _outline.first, _outline.second}) > INT32_MAX) {
+    throw std::runtime_error("floorplan too large for 32-bit coordinates");
+  }
+  _x1.assign(_blocks.size(), 0);
+  _y1.assign(_blocks.size(), 0);
+  _x2.assign(_blocks.size(), 0);
+  _y2.assign(_blocks.size(), 0);
+
+  _block_nets.resize(_blocks.size());
+  _terminal_boxes.resize(_nets.size());
+  for(size_t n = 0; n < _nets.size(); ++n) {
+    _net_pin_begin.push_back(_net_pins.size());
+    for(auto* b: _nets[n]._blocks) {
+      _block_nets[b->_id].push_back(n);
+      _net_pins.push_back(b->_id);
+    }
+    _num_pins += _nets[n]._blocks.size();
+
+    auto& box = _terminal_boxes[n];
+    for(auto* t: _nets[n]._terminals) {
+      uint32_t x = 2 * t->_x;
+      uint32_t y = 2 * t->_y;
+      box.x_min = std::min(box.x_min, x);
+      box.x_max = std::max(box.x_max, x);
+      box.y_min = std::min(box.y_min, y);
+      box.y_max = std::max(box.y_max, y);
+    }
+  }
+  _net_pin_begin.push_back(_net_pins.size());
+  _net_boxes.resize(_nets.size());
+  _net_length2.resize(_nets.size());
+  _is_dirty.resize(_nets.size(), false);
+  _is_stale.resize(_nets.size(), false);
+  _cx.resize(_blocks.size());
+  _cy.resize(_blocks.size());
+  _sweep_wirelength();
+}
+
+void Floorplan::_update_average() {
+
+  _area_average *= _iter;
+  _wire_length_average *= _iter;
+  _penalty_average *= _iter;
+
+  _area_average += _chip_area;
+  _wire_length_average += _wire_length;
+  _penalty_average += _get_penalty();
+
+  _area_average /= (_iter + 1);
+  _wire_length_average /= (_iter + 1);
+  _penalty_average /= (_iter + 1);
+
+  ++_iter;
+}
+
+double Floorplan::_get_penalty() {
+  double penalty = overflow2(_x2.data() + 2, _y2.data() + 2, _num_blocks, _outline.first, _outline.second);
+
+  if(_chip_width > _outline.first && _chip_height < _outline.second ) {
+    penalty += (_chip_width - _outline.first) * _outline.second;
+   }
+  else if(_chip_width < _outline.first && _chip_height > _outline.second) {
+    penalty += (_chip_height - _outline.second) * _outline.first;
+  }
+  else if (_chip_width > _outline.first && _chip_height > _outline.second) {
+    penalty += _chip_height * _chip_width - _outline.second * _outline.first;
+  }
+  return std::sqrt(penalty);
+}
+
+// engines that place every block: the blocks whose center moved are found
+// in O(n)
+void Floorplan::_set_wirelength() {
+  _shifted.clear();
+  shifted(
+    _x1.data(), _x2.data(), _cx.data(),
+    _y1.data(), _y2.data(), _cy.data(),
+    2, _num_blocks + 2, _shifted
+  );
+  _set_wirelength(_shifted);
+}
+
+// only the nets of the given blocks, the only ones that may have moved
+void Floorplan::_set_wirelength(const std::vector<size_t>& moved) {
+
+  // a move that shifts more than an eighth of the blocks touches most nets,
+  // a plain sweep is cheaper
+  if(8 * moved.size() > _blocks.size()) {
+    _sweep_wirelength();
+    return;
+  }
+
+  for(auto i: moved) {
+    _move_pin(i);
+  }
+  _update_nets();
+}
+
+// every box and the total from scratch
+void Floorplan::_sweep_wirelength() {
+  add_u32(_x1.data(), _x2.data(), _cx.data(), _blocks.size());
+  add_u32(_y1.data(), _y2.data(), _cy.data(), _blocks.size());
+
+  size_t wire_length2{0};
+  for(size_t n = 0; n < _nets.size(); ++n) {
+    auto box = _net_box(n);
+    auto length2 = _length2(box);
+    _net_boxes[n] = box;
+    _net_length2[n] = length2;
+    wire_length2 += length2;
+  }
+  _wire_length2 = wire_length2;
+  _wire_length = _wire_length2 / 2.0f;
+}
+
+// moves the pins of block id to its current center. a box that only grows
+// is kept exact in O(1); one whose edge a pin left is rebuilt once, by
+// _update_nets, however many of its pins moved.
+void Floorplan::_move_pin(size_t id) {
+  std::pair<uint32_t, uint32_t> from{_cx[id], _cy[id]};
+  std::pair<uint32_t, uint32_t> to{_x1[id] + _x2[id], _y1[id] + _y2[id]};
+  if(from == to) {
+    return;
+  }
+  _cx[id] = to.first;
+  _cy[id] = to.second;
+
+  for(auto n: _block_nets[id]) {
+    if(!_is_dirty[n]) {
+      _is_dirty[n] = true;
+      _dirty_nets.push_back(n);
+    }
+    if(_is_stale[n]) {
+      continue;
+    }
+
+    auto& box = _net_boxes[n];
+    if((from.first == box.x_min && to.first > from.first) ||
+       (from.first == box.x_max && to.first < from.first) ||
+       (from.second == box.y_min && to.second > from.second) ||
+       (from.second == box.y_max && to.second < from.second)) {
+      _is_stale[n] = true;
+    }
+    else {
+      box.x_min = std::min(box.x_min, to.first);
+      box.x_max = std::max(box.x_max, to.first);
+      box.y_min = std::min(box.y_min, to.second);
+      box.y_max = std::max(box.y_max, to.second);
+    }
+  }
+}
+
+// new lengths of the nets _move_pin touched
+void Floorplan::_update_nets() {
+  for(auto n: _dirty_nets) {
+    if(_is_stale[n]) {
+      _net_boxes[n] = _net_box(n);
+      _is_stale[n] = false;
+    }
+    _is_dirty[n] = false;
+
+    auto length2 = _length2(_net_boxes[n]);
+    _wire_length2 += length2 - _net_length2[n];
+    _net_length2[n] = length2;
+  }
+  _dirty_nets.clear();
+
+  _wire_length = _wire_length2 / 2.0f;
+}
+
+inline
+Floorplan::Box Floorplan::_net_box(size_t n) const {
+  auto [x_min, x_max, y_min, y_max] = _terminal_boxes[n];
+  for(auto p = _net_pin_begin[n]; p < _net_pin_begin[n + 1]; ++p) {
+    auto x = _cx[_net_pins[p]];
+    auto y = _cy[_net_pins[p]];
+    x_min = std::min(x_min, x);
+    x_max = std::max(x_max, x);
+    y_min = std::min(y_min, y);
+    y_max = std::max(y_max, y);
+  }
+  return {x_min, x_max, y_min, y_max};
+}
+
+inline
+size_t Floorplan::_length2(const Box& box) {
+  if(box.x_min > box.x_max) {
+    return 0;
+  }
+  return size_t{box.x_max} - box.x_min + box.y_max - box.y_min;
+}
+
+// block id with its lower-left corner at (x1, y1)
+inline
+void Floorplan::_locate(size_t id, uint32_t x1, uint32_t y1) {
+  _x1[id] = x1;
+  _y1[id] = y1;
+  _x2[id] = x1 + _width[id];
+  _y2[id] = y1 + _height[id];
+}
+
+// pushes the blocks left and down until none moves any further. width and
+// height never grow; the wirelength may, so the compacted floorplan is kept
+// only if it does not raise the area/wirelength cost.
+void Floorplan::_compact() {
+  auto x1 = _x1;
+  auto y1 = _y1;
+  auto x2 = _x2;
+  auto y2 = _y2;
+  auto cost = [this]() {
+    return _alpha * _chip_area / _area_average + (1 - _alpha) * _wire_length / _wire_length_average;
+  };
+  auto before = cost();
+
+  for(bool moved = true; moved; ) {
+    auto moved_x = _slide(_x1, _x2, _y1, _y2);
+    auto moved_y = _slide(_y1, _y2, _x1, _x2);
+    moved = moved_x || moved_y;
+  }
+
+#ifdef SP_CHECK
+  for(size_t i = 2; i < _num_blocks + 2; ++i) {
+    if(_is_overlapped(i)) {
+      throw std::runtime_error("compaction overlaps " + _blocks[i]->_name);
+    }
+  }
+#endif
+
+  _chip_width = max_u32(_x2.data() + 2, _num_blocks);
+  _chip_height = max_u32(_y2.data() + 2, _num_blocks);
+  _chip_area = _chip_height * _chip_width;
+  _sweep_wirelength();
+
+  if(cost() > before) {
+    _x1 = std::move(x1);
+    _y1 = std::move(y1);
+    _x2 = std::move(x2);
+    _y2 = std::move(y2);
+    _chip_width = max_u32(_x2.data() + 2, _num_blocks);
+    _chip_height = max_u32(_y2.data() + 2, _num_blocks);
+    _chip_area = _chip_height * _chip_width;
+    _sweep_wirelength();
+  }
+}
+
+// one compaction pass along the axis of lo/hi. in order of lo, every block
+// drops onto the blocks already placed whose cross intervals overlap its own,
+// i.e. ends up at the highest hi among them, or at 0. a skyline over the
+// cross axis answers that in O(log n): a segment tree of maxima over the
+// intervals between consecutive cross coordinates, where a placed block
+// raises its range. O(n log n) per pass. in a legal floorplan those blocks
+// were already below the block, so none moves up.
+bool Floorplan::_slide(
+  std::vector<uint32_t>& lo,
+  std::vector<uint32_t>& hi,
+  const std::vector<uint32_t>& cross_lo,
+  const std::vector<uint32_t>& cross_hi
+) {
+  std::vector<size_t> order(_num_blocks);
+  std::iota(order.begin(), order.end(), 2);
+  std::stable_sort(order.begin(), order.end(), [&lo](size_t a, size_t b) {
+    return lo[a] < lo[b];
+  });
+
+  std::vector<uint32_t> cuts;
+  cuts.reserve(2 * _num_blocks);
+  for(size_t i = 2; i < _num_blocks + 2; ++i) {
+    cuts.push_back(cross_lo[i]);
+    cuts.push_back(cross_hi[i]);
+  }
+  std::sort(cuts.begin(), cuts.end());
+  cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+  auto cut = [&cuts](uint32_t c) {
+    return std::lower_bound(cuts.begin(), cuts.end(), c) - cuts.begin();
+  };
+
+  // leaf k is [cuts[k], cuts[k + 1]). a raise is kept in raised[] of the
+  // nodes covering its range and counts for all their leaves; top[] is the
+  // highest raise at or below a node.
+  size_t size{1};
+  while(size < cuts.size()) {
+    size <<= 1;
+  }
+  std::vector<uint32_t> raised(2 * size, 0);
+  std::vector<uint32_t> top(2 * size, 0);
+
+  auto height = [&](size_t l, size_t r) {
+    uint32_t h{0};
+    for(auto p = (l + size) >> 1; p > 0; p >>= 1) {
+      h = std::max(h, raised[p]);
+    }
+    for(auto p = (r - 1 + size) >> 1; p > 0; p >>= 1) {
+      h = std::max(h, raised[p]);
+    }
+    for(l += size, r += size; l < r; l >>= 1, r >>= 1) {
+      if(l & 1) {
+        h = std::max(h, top[l++]);
+      }
+      if(r & 1) {
+        h = std::max(h, top[--r]);
+      }
+    }
+    return h;
+  };
+
+  auto raise = [&](size_t l, size_t r, uint32_t h) {
+    auto l0 = l + size;
+    auto r0 = r - 1 + size;
+    for(l += size, r += size; l < r; l >>= 1, r >>= 1) {
+      if(l & 1) {
+        raised[l] = std::max(raised[l], h);
+        top[l] = std::max(top[l], h);
+        ++l;
+      }
+      if(r & 1) {
+        --r;
+        raised[r] = std::max(raised[r], h);
+        top[r] = std::max(top[r], h);
+      }
+    }
+    for(auto p: {l0 >> 1, r0 >> 1}) {
+      for(; p > 0; p >>= 1) {
+        top[p] = std::max({raised[p], top[2 * p], top[2 * p + 1]});
+      }
+    }
+  };
+
+  bool moved{false};
+  for(auto i: order) {
+    auto l = cut(cross_lo[i]);
+    auto r = cut(cross_hi[i]);
+    if(l == r) {
+      continue;
+    }
+    auto to = height(l, r);
+    if(to != lo[i]) {
+      hi[i] -= lo[i] - to;
+      lo[i] = to;
+      moved = true;
+    }
+    raise(l, r, hi[i]);
+  }
+  return moved;
+}
+
+// whether block id overlaps any other block
+bool Floorplan::_is_overlapped(size_t id) const {
+  auto end = _num_blocks + 2;
+  return overlapping(
+    _x1.data(), _y1.data(), _x2.data(), _y2.data(), 2, end, id,
+    _x1[id], _y1[id], _x2[id], _y2[id]
+  ) != end;
+}
+
+void Floorplan::dump(std::ostream& os) {
+
+  _toc = std::chrono::steady_clock::now();
+  _runtime = std::chrono::duration_cast<std::chrono::seconds>(_toc - _tic).count();
+
+  os << _cost        << "\n";
+  os << _wire_length << "\n";
+  os << _chip_area   << "\n";
+  os << _chip_width  << " "   << _chip_height << "\n";
+  os << _runtime     << "\n";
+
+  for(size_t i = 2; i < _num_blocks + 2; ++i) {
+    os << _blocks[i]->_name << " " << _x1[i] << " " << _y1[i] << " " << _x2[i] << " " << _y2[i] << "\n";
+  }
+}
+
+void Floorplan::_parse_block(
+  const std::filesystem::path& blockf
+) {
+  auto sstream = read_file_to_sstream(blockf);
+  std::string line;
+  std::string tmp;
+
+
+  // outline
+  std::getline(sstream, line);
+  if(line.find("Outline") != std::string::npos) {
+    line = line.substr(line.find(": ") + 1);
+    std::stringstream line_stream(line);
+
+    std::getline(line_stream, tmp, ' ');
+    std::getline(line_stream, tmp, ' ');
+    _outline.first = std::stoi(tmp);
+    std::getline(line_stream, tmp, ' ');
+    _outline.second = std::stoi(tmp);
+
+  }
+  else {
+    assert(false);
+  }
+
+  // numblocks
+  std::getline(sstream, line);
+  if(line.find("NumBlocks") != std::string::npos) {
+    _num_blocks = std::stoi(line.substr(line.find(": ") + 1));
+  }
+  else {
+    assert(false);
+  }
+
+  // numterminals
+  std::getline(sstream, line);
+  if(line.find("NumTerminals") != std::string::npos) {
+    _num_terminals = std::stoi(line.substr(line.find(": ") + 1));
+  }
+  else {
+    assert(false);
+  }
+
+  _blocks.reserve(_num_blocks + 2);
+  _blocks_map.reserve(_num_blocks + 2);
+  _terminals_map.reserve(_num_terminals);
+
+
+  while(std::getline(sstream, line)) {
+
+    if(!line.empty() && (line[line.length() - 1] == '\r' || line[line.length() - 1] == '\n')) {
+      line.erase(line.length() - 1);
+    }
+    if(!line.empty() && (line[line.length() - 1] == '\r' || line[line.length() - 1] == '\n')) {
+      line.erase(line.length() - 1);
+    }
+
+    if(line.size() > 1) {
+      if(line.find_first_not_of(' ') == std::string::npos) { continue; }
+      std::stringstream line_stream(line);
+      std::string token;
+      std::vector<std::string> tokens;
+
+
+      if(line.find("terminal") != std::string::npos) {
+        while(std::getline(line_stream, token, ' ')) {
+          if(token != "" && token != " " && token != "\r") {
+            tokens.push_back(token);
+          }
+        }
+
+        std::string tmp1, tmp2, tmp3;
+        std::stringstream term_stream(tokens[2]);
+        tmp1 = tokens[0];
+        std::getline(term_stream, tmp2, '\t');
+        std::getline(term_stream, tmp3, '\n');
+        _terminals_map.emplace(
+          std::piecewise_construct, 
+          std::forward_as_tuple(tmp1), 
+          std::forward_as_tuple(tmp1, _terminals_map.size(), std::stoi(tmp2), std::stoi(tmp3))
+        );
+      }
+      else {
+        while(std::getline(line_stream, token, ' ')) {
+          if(token != "" && token != " " && token != "\r") {
+            tokens.push_back(token);
+          }
+        }
+        if(tokens.size() < 3) {
+          // this is to handle 3.block...
+          tokens.clear();
+          std::stringstream line_stream(line);
+          while(std::getline(line_stream, token, '\t')) {
+            if(token != "" && token != " " && token != "\r") {
+              if(token[token.length() - 1] == '\r' || token[token.length() - 1] == '\n' || token[token.length() - 1] == ' ') {
+                token.erase(token.length() - 1);
+              }
+              tokens.push_back(token);
+            }
+          }
+        }
+
+        auto tmp = _blocks_map.emplace(
+          std::piecewise_construct, 
+          std::forward_as_tuple(tokens[0]), 
+          std::forward_as_tuple(tokens[0], _blocks_map.size())
+        );
+        auto& b = (*(tmp.first)).second;
+        _blocks.push_back(&b);
+        _height.push_back(std::stoi(tokens[1]));
+        _width.push_back(std::stoi(tokens[2]));
+      }
+    }
+  }
+
+  assert(_blocks.size() == _num_blocks + 2);
+  assert(_blocks_map.size() == _num_blocks + 2);
+  assert(_terminals_map.size() == _num_terminals);
+}
+
+void Floorplan::_parse_net(
+  const std::filesystem::path& netf
+) {
+  auto sstream = read_file_to_sstream(netf);
+  std::string line;
+
+
+  // numnets
+  std::getline(sstream, line);
+  if(line.find("NumNets") != std::string::npos) {
+    _num_nets = std::stoi(line.substr(line.find(": ") + 1));
+  }
+  else {
+    assert(false);
+  }
+
+  size_t degree{0};
+  std::vector<Block*> blocks;
+  std::vector<Terminal*> terminals;
+  while(std::getline(sstream, line)) {
+    if(!line.empty() && (line[line.length() - 1] == '\r' || line[line.length() - 1] == '\n')) {
+      line.erase(line.length() - 1);
+    }
+
+    if(line.find("NetDegree") != std::string::npos) {
+      if(degree != 0) {
+        _nets.emplace_back(blocks, terminals, degree);
+      }
+
+      blocks.clear();
+      terminals.clear();
+
+      degree = std::stoi(line.substr(line.find(": ") + 1));
+      blocks.reserve(degree);
+      terminals.reserve(degree / 2);
+    }
+    else {
+      auto btmp = _blocks_map.find(line);
+      if(btmp != _blocks_map.end()) {
+        blocks.push_back(&(btmp->second));
+      }
+      else { 
+        auto ttmp = _terminals_map.find(line);
+        if(ttmp != _terminals_map.end()) {
+          terminals.push_back(&(ttmp->second));
+        }
+        else {
+          assert(false);
+        }
+      }
+    }
+  }
+
+  if(degree != 0) {
+    _nets.emplace_back(blocks, terminals, degree);
+  }
+
+  assert(_nets.size() == _num_nets);
+}
+
+} // end of namespace ===================================================
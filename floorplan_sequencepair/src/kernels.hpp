@@ -0,0 +1,272 @@
+#pragma once
+#include <declarations.h>
+
+namespace fp { // begin of namespace ====================================
+
+// scans over the coordinate arrays of a floorplan (32-bit, indexed by block
+// id). each has a scalar version and, on x86-64, an AVX2 one picked at run
+// time, so the build needs no -march flag. coordinates are below 2^31 (the
+// Floorplan constructor checks it), which lets AVX2 compare them as signed.
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define FP_AVX2
+
+inline
+bool has_avx2() {
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+
+namespace avx2 { // begin of namespace avx2 -----------------------------
+
+__attribute__((target("avx2")))
+inline
+__m256i _load(const uint32_t* p) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+__attribute__((target("avx2")))
+inline
+double overflow2(const uint32_t* x2, const uint32_t* y2, size_t n, uint32_t w, uint32_t h) {
+  auto vw = _mm256_set1_epi32(w);
+  auto vh = _mm256_set1_epi32(h);
+  auto sum = _mm256_setzero_pd();
+
+  size_t i{0};
+  for(; i + 8 <= n; i += 8) {
+    auto x = _load(x2 + i);
+    auto y = _load(y2 + i);
+    auto dx = _mm256_sub_epi32(_mm256_max_epu32(x, vw), vw);
+    auto dy = _mm256_sub_epi32(_mm256_max_epu32(y, vh), vh);
+    auto dx_lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(dx));
+    auto dx_hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(dx, 1));
+    auto dy_lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(dy));
+    auto dy_hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(dy, 1));
+    sum = _mm256_add_pd(sum, _mm256_mul_pd(dx_lo, dx_lo));
+    sum = _mm256_add_pd(sum, _mm256_mul_pd(dx_hi, dx_hi));
+    sum = _mm256_add_pd(sum, _mm256_mul_pd(dy_lo, dy_lo));
+    sum = _mm256_add_pd(sum, _mm256_mul_pd(dy_hi, dy_hi));
+  }
+
+  double lanes[4];
+  _mm256_storeu_pd(lanes, sum);
+  double penalty = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  for(; i < n; ++i) {
+    double dx = x2[i] > w ? x2[i] - w : 0;
+    double dy = y2[i] > h ? y2[i] - h : 0;
+    penalty += dx * dx + dy * dy;
+  }
+  return penalty;
+}
+
+__attribute__((target("avx2")))
+inline
+void add_u32(const uint32_t* a, const uint32_t* b, uint32_t* out, size_t n) {
+  size_t i{0};
+  for(; i + 8 <= n; i += 8) {
+    auto va = _load(a + i);
+    auto vb = _load(b + i);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi32(va, vb));
+  }
+  for(; i < n; ++i) {
+    out[i] = a[i] + b[i];
+  }
+}
+
+__attribute__((target("avx2")))
+inline
+void sub_u32(const uint32_t* a, const uint32_t* b, uint32_t* out, size_t n) {
+  size_t i{0};
+  for(; i + 8 <= n; i += 8) {
+    auto va = _load(a + i);
+    auto vb = _load(b + i);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_sub_epi32(va, vb));
+  }
+  for(; i < n; ++i) {
+    out[i] = a[i] - b[i];
+  }
+}
+
+__attribute__((target("avx2")))
+inline
+uint32_t max_u32(const uint32_t* a, size_t n) {
+  auto vm = _mm256_setzero_si256();
+  size_t i{0};
+  for(; i + 8 <= n; i += 8) {
+    vm = _mm256_max_epu32(vm, _load(a + i));
+  }
+
+  uint32_t lanes[8];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), vm);
+  uint32_t m = *std::max_element(lanes, lanes + 8);
+  for(; i < n; ++i) {
+    m = std::max(m, a[i]);
+  }
+  return m;
+}
+
+__attribute__((target("avx2")))
+inline
+void shifted(
+  const uint32_t* x1, const uint32_t* x2, const uint32_t* cx,
+  const uint32_t* y1, const uint32_t* y2, const uint32_t* cy,
+  size_t begin, size_t end, std::vector<size_t>& out
+) {
+  size_t i{begin};
+  for(; i + 8 <= end; i += 8) {
+    auto same = _mm256_and_si256(
+      _mm256_cmpeq_epi32(_mm256_add_epi32(_load(x1 + i), _load(x2 + i)), _load(cx + i)),
+      _mm256_cmpeq_epi32(_mm256_add_epi32(_load(y1 + i), _load(y2 + i)), _load(cy + i))
+    );
+    unsigned mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(same)) & 0xff;
+    while(mask) {
+      out.push_back(i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+  for(; i < end; ++i) {
+    if(x1[i] + x2[i] != cx[i] || y1[i] + y2[i] != cy[i]) {
+      out.push_back(i);
+    }
+  }
+}
+
+__attribute__((target("avx2")))
+inline
+size_t overlapping(
+  const uint32_t* x1, const uint32_t* y1, const uint32_t* x2, const uint32_t* y2,
+  size_t begin, size_t end, size_t skip,
+  uint32_t ax1, uint32_t ay1, uint32_t ax2, uint32_t ay2
+) {
+  auto vx1 = _mm256_set1_epi32(ax1);
+  auto vy1 = _mm256_set1_epi32(ay1);
+  auto vx2 = _mm256_set1_epi32(ax2);
+  auto vy2 = _mm256_set1_epi32(ay2);
+
+  size_t i{begin};
+  for(; i + 8 <= end; i += 8) {
+    auto hit = _mm256_and_si256(
+      _mm256_and_si256(_mm256_cmpgt_epi32(vx2, _load(x1 + i)), _mm256_cmpgt_epi32(_load(x2 + i), vx1)),
+      _mm256_and_si256(_mm256_cmpgt_epi32(vy2, _load(y1 + i)), _mm256_cmpgt_epi32(_load(y2 + i), vy1))
+    );
+    unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(hit));
+    if(skip >= i && skip < i + 8) {
+      mask &= ~(1u << (skip - i));
+    }
+    if(mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  for(; i < end; ++i) {
+    if(i != skip && ax2 > x1[i] && x2[i] > ax1 && ay2 > y1[i] && y2[i] > ay1) {
+      return i;
+    }
+  }
+  return end;
+}
+
+} // end of namespace avx2 ----------------------------------------------
+
+#endif
+
+// sum over n blocks of the squared overflow of their right edges past w and
+// of their top edges past h; exact while it stays below 2^53
+inline
+double overflow2(const uint32_t* x2, const uint32_t* y2, size_t n, uint32_t w, uint32_t h) {
+#ifdef FP_AVX2
+  if(has_avx2()) {
+    return avx2::overflow2(x2, y2, n, w, h);
+  }
+#endif
+  double penalty{0};
+  for(size_t i = 0; i < n; ++i) {
+    double dx = x2[i] > w ? x2[i] - w : 0;
+    double dy = y2[i] > h ? y2[i] - h : 0;
+    penalty += dx * dx + dy * dy;
+  }
+  return penalty;
+}
+
+// out[i] = a[i] + b[i]
+inline
+void add_u32(const uint32_t* a, const uint32_t* b, uint32_t* out, size_t n) {
+#ifdef FP_AVX2
+  if(has_avx2()) {
+    return avx2::add_u32(a, b, out, n);
+  }
+#endif
+  for(size_t i = 0; i < n; ++i) {
+    out[i] = a[i] + b[i];
+  }
+}
+
+// out[i] = a[i] - b[i]
+inline
+void sub_u32(const uint32_t* a, const uint32_t* b, uint32_t* out, size_t n) {
+#ifdef FP_AVX2
+  if(has_avx2()) {
+    return avx2::sub_u32(a, b, out, n);
+  }
+#endif
+  for(size_t i = 0; i < n; ++i) {
+    out[i] = a[i] - b[i];
+  }
+}
+
+// largest of a[0, n), 0 if n is 0
+inline
+uint32_t max_u32(const uint32_t* a, size_t n) {
+#ifdef FP_AVX2
+  if(has_avx2()) {
+    return avx2::max_u32(a, n);
+  }
+#endif
+  uint32_t m{0};
+  for(size_t i = 0; i < n; ++i) {
+    m = std::max(m, a[i]);
+  }
+  return m;
+}
+
+// appends to out, in order, every i in [begin, end) whose doubled center
+// (x1 + x2, y1 + y2) is no longer (cx, cy)
+inline
+void shifted(
+  const uint32_t* x1, const uint32_t* x2, const uint32_t* cx,
+  const uint32_t* y1, const uint32_t* y2, const uint32_t* cy,
+  size_t begin, size_t end, std::vector<size_t>& out
+) {
+#ifdef FP_AVX2
+  if(has_avx2()) {
+    return avx2::shifted(x1, x2, cx, y1, y2, cy, begin, end, out);
+  }
+#endif
+  for(size_t i = begin; i < end; ++i) {
+    if(x1[i] + x2[i] != cx[i] || y1[i] + y2[i] != cy[i]) {
+      out.push_back(i);
+    }
+  }
+}
+
+// the first i in [begin, end) other than skip whose rectangle overlaps
+// (ax1, ay1)-(ax2, ay2) with a positive area, end if none does
+inline
+size_t overlapping(
+  const uint32_t* x1, const uint32_t* y1, const uint32_t* x2, const uint32_t* y2,
+  size_t begin, size_t end, size_t skip,
+  uint32_t ax1, uint32_t ay1, uint32_t ax2, uint32_t ay2
+) {
+#ifdef FP_AVX2
+  if(has_avx2()) {
+    return avx2::overlapping(x1, y1, x2, y2, begin, end, skip, ax1, ay1, ax2, ay2);
+  }
+#endif
+  for(size_t i = begin; i < end; ++i) {
+    if(i != skip && ax2 > x1[i] && x2[i] > ax1 && ay2 > y1[i] && y2[i] > ay1) {
+      return i;
+    }
+  }
+  return end;
+}
+
+} // end of namespace ===================================================
@@ -5,7 +5,10 @@ namespace fp { // begin of namespace ====================================
 
 
 class Net {
+  friend class Floorplan;
   friend class SP;
+  friend class BStarTree;
+  friend class Slicing;
 
   public:
 
@@ -5,54 +5,111 @@
 #include <src/terminal.hpp>
 #include <src/net.hpp>
 #include <src/sp.hpp>
+#include <src/bstar_tree.hpp>
+#include <src/slicing.hpp>
 
 namespace fp { // begin of namespace ====================================
 
-class ParallelSP {
+// runs num_threads annealers of one engine (SP, BStarTree or Slicing) and restarts
+// them all from the best one after every round, or, with tempering, keeps one
+// annealer per temperature and lets neighboring temperatures swap floorplans,
+// or, with sharing, lets every annealer run its own rounds and exchange best
+// solutions through a lock-free slot
+template <typename T>
+class Parallel {
 
   public:
 
-    ParallelSP(
+    Parallel(
       const float alpha,
       const std::filesystem::path& blockf, 
       const std::filesystem::path& netf,
-      const size_t num_threads = 8
+      const size_t num_threads = 8,
+      const std::mt19937::result_type seed = std::random_device{}()
     );
 
     void apply();
     void dump(std::ostream& os);
+    void set_tempering(bool tempering);
+    void set_sharing(bool sharing);
+    void set_adaptive(bool adaptive);
 
   private:
 
-    std::vector<SP> _sps;
+    using Snapshot = typename T::Snapshot;
+
+    bool _tempering{false};
+    bool _sharing{false};
+    bool _adaptive{false};
+
+    std::vector<T> _sps;
     size_t _num_threads;
   
-    SP* _best_sp{nullptr};
+    T* _best_sp{nullptr};
 
     void _update_best();
     void _update_average();
-    std::random_device _rd{};
-    std::mt19937 _eng{_rd()};
+    void _anneal(T& sp, double temp, size_t num_moves);
+    void _temper();
+    void _share();
+    template <typename F>
+    void _schedule(T& sp, F&& step);
+    void _publish(size_t k);
+    bool _adopt(size_t k);
+    void _reclaim(size_t k);
+    std::mt19937 _stream(size_t k) const;
+
+    // annealer k draws from stream k of the seed and the ladder swaps from
+    // stream num_threads, so a run is reproduced by its seed and thread count
+    std::mt19937::result_type _seed;
+    std::mt19937 _eng;
+
+    // best solution published so far; a snapshot is immutable and is deleted
+    // only once no annealer can still be reading it (epoch-based reclamation):
+    // _reading[k] is the epoch annealer k entered its read in, 0 outside
+    // reads, and a snapshot retired at epoch e is safe once every read in
+    // progress entered at e or later. _shared_cost is the cost of the shared
+    // snapshot or, briefly after a publish, above it, which lets an annealer
+    // with nothing to adopt skip the read
+    std::atomic<Snapshot*> _shared{nullptr};
+    std::atomic<double> _shared_cost{std::numeric_limits<double>::infinity()};
+    std::atomic<size_t> _epoch{1};
+    std::unique_ptr<std::atomic<size_t>[]> _reading;
+    std::vector<std::vector<std::pair<Snapshot*, size_t>>> _retired;
+    std::atomic<bool> _done{false};
+    std::atomic<size_t> _num_adoptions{0};
 
 };
 
-ParallelSP::ParallelSP(
+template <typename T>
+Parallel<T>::Parallel(
   const float alpha,
   const std::filesystem::path& blockf, 
   const std::filesystem::path& netf,
-  const size_t num_threads
-): _num_threads{num_threads} {
+  const size_t num_threads,
+  const std::mt19937::result_type seed
+): _num_threads{num_threads}, _seed{seed} {
 
 
   for(size_t i = 0; i < _num_threads; ++i) {
     //_sps.emplace_back(alpha, blockf, netf);
-    _sps.emplace_back(alpha, blockf, netf, _eng);
+    _sps.emplace_back(alpha, blockf, netf, _stream(i));
   }
+  _eng = _stream(_num_threads);
 
   _update_average();
 }
 
-void ParallelSP::_update_average() {
+// independent streams of one seed: seed_seq mixes the stream index into
+// the whole generator state
+template <typename T>
+std::mt19937 Parallel<T>::_stream(size_t k) const {
+  std::seed_seq seq{static_cast<size_t>(_seed), k};
+  return std::mt19937{seq};
+}
+
+template <typename T>
+void Parallel<T>::_update_average() {
   double area_average{0};
   double wire_length_average{0};
   double penalty_average{0};
@@ -74,7 +131,8 @@ void ParallelSP::_update_average() {
   }
 }
 
-void ParallelSP::_update_best() {
+template <typename T>
+void Parallel<T>::_update_best() {
 
   //_best_sp = &(*std::min_element(
     //_sps.begin(), 
@@ -90,20 +148,14 @@ void ParallelSP::_update_best() {
   }
 
   for(auto& sp: _sps) {
-    sp._best_first_seq = _best_sp->_best_first_seq;
-    sp._best_second_seq = _best_sp->_best_second_seq;
-    sp._best_first_seq_id_loc_map = _best_sp->_best_first_seq_id_loc_map;
-    sp._best_second_seq_id_loc_map = _best_sp->_best_second_seq_id_loc_map;
-    sp._best_block_wh = _best_sp->_best_block_wh;
-    sp._cost = _best_sp->_best_cost;
-
-    sp._update_all_to_best();
+    sp._adopt_best(*_best_sp);
   }
 
   _update_average();
 }
 
-void ParallelSP::apply() {
+template <typename T>
+void Parallel<T>::apply() {
 
   //_update_best();
 
@@ -113,24 +165,25 @@ void ParallelSP::apply() {
 
 
   std::cout << "===================================================================================\n\n"
-            << "                            Sequence-pair Placement           \n\n"
-            << "./sp alpha input_file output_file num_threads (number of threads to find solution) \n\n"
-            << "#1. I randomly initialize sequence pair and apply SA to improve cost.\n\n"
+            << "                            " << T::title << "           \n\n"
+            << "./sp alpha input_block_file input_net_file output_file num_threads [--engine sp|btree|slicing] [--tempering | --sharing] [--adaptive] [--seed n]\n\n"
+            << "#1. I randomly initialize the floorplan and apply SA to improve cost.\n\n"
             << "#2. The number of thread should be always larger than 0. \n\n"
             << "#3. I apply openmp to find solution in parallel.\n"
-            << "Each thread will create its sequence pair and perform SA. \n"
-            << "After SA, I will find the best solution and update each thread's sequence pair to the best.\n\n"
+            << "Each thread will create its floorplan and perform SA. \n"
+            << "After SA, I will find the best solution and update each thread's floorplan to the best.\n\n"
             << "#4. I run SA at most 30 times.\n\n"
             << "#5. My cost function only considers whether the solution is legal.\n"
             << "I will jump out of SA loop once I find a legal solution.\n\n"
-            << "#6. Finally, I will apply compress() to get the best result.\n\n"
+            << "#6. Finally, I will compact the best floorplan left and down.\n\n"
             << "====================================================================================\n\n";
 
 
   std::cout << "Outline: "              << _sps[0]._outline.first << ", "   << _sps[0]._outline.second << "\n"
             << "Number of blocks: "     << _sps[0]._num_blocks    << "\n"
             << "Number of terminals: "  << _sps[0]._num_terminals << "\n"
-            << "Number of threads: "    << _num_threads           << "\n\n";
+            << "Number of threads: "    << _num_threads           << "\n"
+            << "Seed: "                 << _seed                  << "\n\n";
 
   std::cout << "===========================\n\n";
 
@@ -140,23 +193,34 @@ void ParallelSP::apply() {
 
   omp_set_num_threads(_num_threads);
 
-  while(!is_legal && count < 30) {
+  if(_tempering) {
+    _temper();
+  }
+  else if(_sharing) {
+    _share();
+  }
+  else {
+    while(!is_legal && count < 30) {
 
-    #pragma omp parallel for
-    for(size_t i = 0; i < _sps.size(); ++i) {
-      _sps[i].apply();
-    }
+      #pragma omp parallel for
+      for(size_t i = 0; i < _sps.size(); ++i) {
+        _schedule(_sps[i], []{ return true; });
+      }
 
-    _update_best();
+      _update_best();
 
-    std::cout << "best cost at iter "      << count << ": " << _best_sp->_cost << "\n";
+      std::cout << "best cost at iter "      << count << ": " << _best_sp->_cost << "\n";
 
-    std::cout << "best chip area at iter " << count << ": " << "width: "       
-              << _best_sp->_chip_width << " height: " << _best_sp->_chip_height << "\n\n"; 
-    ++count;
-    is_legal = (_best_sp->_chip_width <= width) && (_best_sp->_chip_height <= height);
+      std::cout << "best chip area at iter " << count << ": " << "width: "       
+                << _best_sp->_chip_width << " height: " << _best_sp->_chip_height << "\n\n"; 
+      ++count;
+      is_legal = (_best_sp->_chip_width <= width) && (_best_sp->_chip_height <= height);
+    }
   }
 
+  _best_sp->_compact();
+  std::cout << "compacted chip area: width: " << _best_sp->_chip_width << " height: " << _best_sp->_chip_height << "\n\n";
+
 
   //double out_width{0};
   //double out_height{0};
@@ -171,9 +235,354 @@ void ParallelSP::apply() {
 
 }
 
-void ParallelSP::dump(std::ostream& os) {
+// num_moves Metropolis steps of sp at a fixed temperature, the same for
+// every engine: it perturbs with _move and evaluates with _get_results
+template <typename T>
+void Parallel<T>::_anneal(T& sp, double temp, size_t num_moves) {
+
+  std::uniform_real_distribution dist(0.f, 1.f);
+  double beta = 1000;
+
+  for(size_t i = 0; i < num_moves; ++i) {
+    sp._move();
+
+    sp._get_results();
+
+    sp._cost = sp._get_penalty() / sp._penalty_average;
+    if(sp._cost < sp._prev_cost) {
+      sp._accept();
+      ++sp._num_accepted;
+      if(sp._cost < sp._best_cost) {
+        sp._update_best();
+        sp._update_average();
+      }
+    }
+    else {
+      ++sp._num_uphill;
+      sp._uphill += sp._cost - sp._prev_cost;
+
+      auto random = dist(sp._eng);
+      double accr = std::exp((sp._cost - sp._prev_cost) * beta * -1 / temp);
+
+      if(accr > random) {
+        sp._accept();
+        ++sp._num_accepted;
+      }
+      else {
+        sp._reject();
+      }
+    }
+  }
+}
+
+// replica exchange: the k-th rung of the ladder anneals at a fixed temperature,
+// geometric between the ends of the annealing schedule (5 and 5000). after
+// every sweep neighboring rungs swap their floorplans with probability
+// min(1, exp((1/T_k - 1/T_k+1) (E_k - E_k+1))), in the cost scale _anneal
+// uses. the ladder holds pointers, so a swap never copies a floorplan.
+template <typename T>
+void Parallel<T>::_temper() {
+
+  std::uniform_real_distribution<double> dist(0, 1);
+  double beta = 1000;
+  double t_min{5};
+  double t_max{5000};
+
+  // as many moves per replica as 30 rounds of the annealing schedule
+  size_t sweeps_per_round{43};
+  size_t num_sweeps{30 * sweeps_per_round};
+
+  std::vector<T*> ladder;
+  std::vector<double> temps;
+  for(size_t k = 0; k < _sps.size(); ++k) {
+    ladder.push_back(&_sps[k]);
+    temps.push_back(_sps.size() == 1 ? t_min : t_min * std::pow(t_max / t_min, k / (_sps.size() - 1.0)));
+  }
+
+  bool is_legal{false};
+  size_t num_tries{0};
+  size_t num_swaps{0};
+
+  for(size_t sweep = 0; !is_legal && sweep < num_sweeps; ++sweep) {
+
+    #pragma omp parallel for
+    for(size_t k = 0; k < ladder.size(); ++k) {
+      _anneal(*ladder[k], temps[k], 3000);
+    }
+
+    _update_average();
+
+    for(size_t k = sweep % 2; k + 1 < ladder.size(); k += 2) {
+      auto delta = (1 / temps[k] - 1 / temps[k + 1]) * (ladder[k]->_cost - ladder[k + 1]->_cost) * beta;
+      ++num_tries;
+      if(delta >= 0 || dist(_eng) < std::exp(delta)) {
+        std::swap(ladder[k], ladder[k + 1]);
+        ++num_swaps;
+      }
+    }
+
+    _best_sp = &_sps[0];
+    for(auto& sp: _sps) {
+      if(_best_sp->_best_cost > sp._best_cost) {
+        _best_sp = &sp;
+      }
+    }
+    is_legal = _best_sp->_best_cost == 0;
+
+    if(is_legal || (sweep + 1) % sweeps_per_round == 0) {
+      std::cout << "best cost at sweep " << sweep << ": " << _best_sp->_best_cost << "\n";
+    }
+  }
+
+  std::cout << "swaps accepted: " << num_swaps << " of " << num_tries << "\n\n";
+
+  _best_sp->_update_all_to_best();
+  _best_sp->_get_results();
+
+  std::cout << "best chip area: width: " << _best_sp->_chip_width << " height: " << _best_sp->_chip_height << "\n\n";
+}
+
+// one round of annealing on sp, which ends at its best solution; step runs
+// after every temperature and ends the round early by returning false.
+//
+// the fixed schedule cools from 5000 to 5 by 0.85 with 3000 moves at every
+// temperature. the adaptive one runs 40 moves per block at every temperature
+// and starts where an average non-improving move, sampled by a random walk,
+// is accepted with probability 0.9. after every temperature it cools (0.85)
+// if more moves were accepted than the target ratio of the modified Lam
+// schedule and heats (1/0.85) otherwise: the target falls from 1 to 0.44 in
+// the first 15% of the 50 temperatures, stays there until 65%, then falls
+// to 0.001. it stops once the best cost reaches 0, or once it is frozen:
+// 3 temperatures in a row accept fewer than 2% of the moves without
+// improving the best cost.
+template <typename T>
+template <typename F>
+void Parallel<T>::_schedule(T& sp, F&& step) {
+
+  if(!_adaptive) {
+    double temp{5000};
+    while(temp > 5) {
+      _anneal(sp, temp, 3000);
+      temp *= 0.85;
+      if(!step()) {
+        break;
+      }
+    }
+  }
+  else {
+    double beta = 1000;
+    size_t num_moves{40 * sp._num_blocks};
+    size_t num_temps{50};
+
+    sp._num_uphill = 0;
+    sp._uphill = 0;
+    _anneal(sp, std::numeric_limits<double>::infinity(), num_moves);
+    auto uphill = sp._num_uphill == 0 ? 0 : sp._uphill / sp._num_uphill;
+    double temp = uphill * beta / -std::log(0.9);
+
+    auto target = [](double t) {
+      if(t < 0.15) {
+        return 0.44 + 0.56 * std::pow(560, -t / 0.15);
+      }
+      if(t < 0.65) {
+        return 0.44;
+      }
+      return 0.44 * std::pow(440, -(t - 0.65) / 0.35);
+    };
+
+    double best{sp._best_cost};
+    size_t num_stale{0};
+    for(size_t k = 0; k < num_temps && sp._best_cost > 0 && num_stale < 3; ++k) {
+      sp._num_accepted = 0;
+      _anneal(sp, temp, num_moves);
+
+      auto ratio = static_cast<double>(sp._num_accepted) / num_moves;
+      temp *= ratio > target(static_cast<double>(k) / num_temps) ? 0.85 : 1 / 0.85;
+
+      if(sp._best_cost < best) {
+        best = sp._best_cost;
+        num_stale = 0;
+      }
+      else if(ratio < 0.02) {
+        ++num_stale;
+      }
+
+      if(!step()) {
+        break;
+      }
+    }
+  }
+
+  sp._update_all_to_best();
+  sp._get_results();
+}
+
+// every annealer runs up to 30 rounds of the schedule on its own, with no
+// barrier between threads. at every temperature step it publishes its best
+// solution if that improved, or else restarts from the published one if that
+// is better than its own and goes on cooling from there. all of them stop at
+// their next temperature step once any solution is legal.
+template <typename T>
+void Parallel<T>::_share() {
+
+  _reading.reset(new std::atomic<size_t>[_sps.size()]);
+  for(size_t k = 0; k < _sps.size(); ++k) {
+    _reading[k] = 0;
+  }
+  _retired.assign(_sps.size(), {});
+
+  std::vector<size_t> rounds(_sps.size(), 0);
+
+  #pragma omp parallel for
+  for(size_t k = 0; k < _sps.size(); ++k) {
+    auto& sp = _sps[k];
+    for(; rounds[k] < 30 && !_done; ++rounds[k]) {
+      _adopt(k);
+
+      double published{sp._best_cost};
+      _schedule(sp, [&]{
+        if(sp._best_cost < published) {
+          _publish(k);
+        }
+        else {
+          _adopt(k);
+        }
+        published = sp._best_cost;
+        return !_done;
+      });
+    }
+  }
+
+  // every thread has joined, nothing is read any more
+  for(auto& retired: _retired) {
+    for(auto& [snapshot, epoch]: retired) {
+      delete snapshot;
+    }
+  }
+  _retired.clear();
+  delete _shared.exchange(nullptr);
+
+  _best_sp = &_sps[0];
+  for(auto& sp: _sps) {
+    if(_best_sp->_best_cost > sp._best_cost) {
+      _best_sp = &sp;
+    }
+  }
+
+  std::cout << "rounds per thread:";
+  for(auto r: rounds) {
+    std::cout << ' ' << r;
+  }
+  std::cout << "\n"
+            << "shared solutions adopted: " << _num_adoptions << "\n"
+            << "best cost: " << _best_sp->_best_cost << "\n\n";
+
+  _best_sp->_update_all_to_best();
+  _best_sp->_get_results();
+
+  std::cout << "best chip area: width: " << _best_sp->_chip_width << " height: " << _best_sp->_chip_height << "\n\n";
+}
+
+// replaces the shared solution with the best one of annealer k unless the
+// shared one is at least as good
+template <typename T>
+void Parallel<T>::_publish(size_t k) {
+  auto* snapshot = new Snapshot(_sps[k]._snapshot());
+  auto cost = snapshot->cost;
+
+  // old is read, so it must not be reclaimed meanwhile
+  _reading[k] = _epoch.load();
+
+  auto* old = _shared.load();
+  do {
+    if(old != nullptr && old->cost <= cost) {
+      _reading[k] = 0;
+      delete snapshot;
+      return;
+    }
+  } while(!_shared.compare_exchange_weak(old, snapshot));
+
+  _reading[k] = 0;
+
+  // publishes race, so _shared_cost only ever goes down
+  auto shared_cost = _shared_cost.load();
+  while(cost < shared_cost && !_shared_cost.compare_exchange_weak(shared_cost, cost));
+
+  if(cost == 0) {
+    _done = true;
+  }
+
+  if(old != nullptr) {
+    _retired[k].emplace_back(old, _epoch.fetch_add(1) + 1);
+  }
+  _reclaim(k);
+}
+
+// restarts annealer k from the shared solution if it is better than its own
+template <typename T>
+bool Parallel<T>::_adopt(size_t k) {
+  if(_shared_cost.load(std::memory_order_relaxed) >= _sps[k]._best_cost) {
+    return false;
+  }
+
+  _reading[k] = _epoch.load();
+
+  auto* snapshot = _shared.load();
+  bool adopted = snapshot != nullptr && snapshot->cost < _sps[k]._best_cost;
+  if(adopted) {
+    _sps[k]._adopt(*snapshot);
+    ++_num_adoptions;
+  }
+
+  _reading[k] = 0;
+  return adopted;
+}
+
+// deletes the snapshots annealer k retired that no read in progress can see
+template <typename T>
+void Parallel<T>::_reclaim(size_t k) {
+  size_t oldest{SIZE_MAX};
+  for(size_t j = 0; j < _sps.size(); ++j) {
+    auto epoch = _reading[j].load();
+    if(epoch != 0) {
+      oldest = std::min(oldest, epoch);
+    }
+  }
+
+  auto& retired = _retired[k];
+  auto it = std::remove_if(retired.begin(), retired.end(), [&](auto& r) {
+    if(r.second <= oldest) {
+      delete r.first;
+      return true;
+    }
+    return false;
+  });
+  retired.erase(it, retired.end());
+}
+
+template <typename T>
+void Parallel<T>::set_tempering(bool tempering) {
+  _tempering = tempering;
+}
+
+template <typename T>
+void Parallel<T>::set_sharing(bool sharing) {
+  _sharing = sharing;
+}
+
+template <typename T>
+void Parallel<T>::set_adaptive(bool adaptive) {
+  _adaptive = adaptive;
+}
+
+template <typename T>
+void Parallel<T>::dump(std::ostream& os) {
   std::cout << "dumping...\n";
   _best_sp->dump(os);
 }
 
+using ParallelSP = Parallel<SP>;
+using ParallelBStarTree = Parallel<BStarTree>;
+using ParallelSlicing = Parallel<Slicing>;
+
 } // end of namespace ===================================================
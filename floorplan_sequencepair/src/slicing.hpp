@@ -0,0 +1,461 @@
+#pragma once
+#include <declarations.h>
+#include <src/utility.hpp>
+#include <src/block.hpp>
+#include <src/terminal.hpp>
+#include <src/net.hpp>
+#include <src/floorplan.hpp>
+
+namespace fp { // begin of namespace ====================================
+
+// slicing floorplan as a normalized Polish expression (Wong & Liu, DAC 1986).
+// operands are block ids, the operators are _v (left operand left of the
+// right one) and _h (left operand below the right one); ids 0 and 1 are src
+// and tgt and never appear as operands. every node keeps the shape curve of
+// its subtree (Stockmeyer), so a block's orientation is picked when the root
+// shape is picked instead of by random rotations.
+class Slicing : public Floorplan {
+
+  template <typename T> friend class Parallel;
+
+  public:
+
+    static constexpr const char* title{"Slicing Placement"};
+
+    Slicing(
+      const float alpha,
+      const std::filesystem::path& blockf,
+      const std::filesystem::path& netf,
+      std::mt19937 eng
+    );
+
+    Slicing(const Slicing& sl) = default;
+    Slicing(Slicing&& sl) = default;
+
+    Slicing& operator= (const Slicing& sl) = default;
+    Slicing& operator= (Slicing&& sl) = default;
+
+    ~Slicing() = default;
+
+  private:
+
+    // a point of a shape curve and the child points it is made of; curves
+    // are sorted by width with strictly decreasing heights
+    struct Shape {
+      size_t w;
+      size_t h;
+      size_t l;
+      size_t r;
+    };
+
+    static constexpr size_t _v{0};
+    static constexpr size_t _h{1};
+
+    void _initialize();
+    void _evaluate();
+    void _place();
+    void _combine(
+      const std::vector<Shape>& a,
+      const std::vector<Shape>& b,
+      size_t op,
+      std::vector<Shape>& curve
+    );
+    const std::vector<Shape>& _curve(size_t pos) const;
+    void _move();
+    bool _swap_operand_operator(size_t pos);
+    void _touch(size_t lo, size_t hi);
+    void _touch_all();
+    void _get_results();
+    void _reject();
+    void _accept();
+    void _update_best();
+    void _update_all_to_best();
+    void _adopt_best(const Slicing& sl);
+
+    // the best solution, never changed once taken
+    struct Snapshot {
+      std::vector<size_t> expr;
+      double cost;
+    };
+
+    Snapshot _snapshot() const;
+    void _adopt(const Snapshot& snapshot);
+
+    std::vector<size_t> _expr;
+    std::vector<size_t> _prev_expr;
+    std::vector<size_t> _best_expr;
+    double _prev_cost;
+    double _best_cost;
+
+    // shape curve and left child of every expression position (the right
+    // child of an operator is always the position before it), and the two
+    // orientations of every block
+    std::vector<std::vector<Shape>> _curves;
+    std::vector<size_t> _left;
+    std::vector<std::vector<Shape>> _leaf_curves;
+
+    // positions changed since the last evaluation (clean if _dirty_lo > _dirty_hi),
+    // and those of the last move
+    size_t _dirty_lo{0};
+    size_t _dirty_hi{0};
+    std::pair<size_t, size_t> _move_range;
+
+    std::vector<size_t> _stack;
+    std::vector<char> _dirty;
+};
+
+Slicing::Slicing(
+  const float alpha,
+  const std::filesystem::path& blockf,
+  const std::filesystem::path& netf,
+  std::mt19937 eng
+): Floorplan(alpha, blockf, netf, std::move(eng)) {
+
+  _leaf_curves.resize(_blocks.size());
+  for(size_t i = 2; i < _num_blocks + 2; ++i) {
+    size_t w = std::min(_width[i], _height[i]);
+    size_t h = std::max(_width[i], _height[i]);
+    _leaf_curves[i].push_back({w, h, 0, 0});
+    if(w != h) {
+      _leaf_curves[i].push_back({h, w, 0, 0});
+    }
+  }
+
+  _curves.resize(2 * _num_blocks - 1);
+  _left.resize(2 * _num_blocks - 1);
+  _dirty.resize(2 * _num_blocks - 1);
+
+  _initialize();
+  _update_average();
+
+  _cost = INT_MAX;
+  _update_best();
+  _update_all_to_best();
+}
+
+// shuffled blocks joined by alternating cuts, b1 b2 V b3 H b4 V ...
+void Slicing::_initialize() {
+  std::vector<size_t> ids(_num_blocks);
+  std::iota(ids.begin(), ids.end(), 2);
+  std::shuffle(ids.begin(), ids.end(), _eng);
+
+  _expr.clear();
+  _expr.push_back(ids[0]);
+  for(size_t i = 1; i < _num_blocks; ++i) {
+    _expr.push_back(ids[i]);
+    _expr.push_back(i % 2 ? _v : _h);
+  }
+
+  _touch_all();
+  _get_results();
+}
+
+void Slicing::_get_results() {
+  _evaluate();
+  _place();
+  _set_wirelength();
+}
+
+const std::vector<Slicing::Shape>& Slicing::_curve(size_t pos) const {
+  return _expr[pos] > _h ? _leaf_curves[_expr[pos]] : _curves[pos];
+}
+
+// postfix walk; positions before _dirty_lo keep their curves and only rebuild
+// the stack, after that a curve is recomputed only if its operator changed or
+// one of its children was recomputed
+void Slicing::_evaluate() {
+  _stack.clear();
+
+  size_t pos{0};
+  for(; pos < _dirty_lo && pos < _expr.size(); ++pos) {
+    if(_expr[pos] > _h) {
+      _stack.push_back(pos);
+    }
+    else {
+      _stack.pop_back();
+      _stack.back() = pos;
+    }
+    _dirty[pos] = false;
+  }
+
+  for(; pos < _expr.size(); ++pos) {
+    bool changed = pos <= _dirty_hi;
+    if(_expr[pos] > _h) {
+      _stack.push_back(pos);
+    }
+    else {
+      auto r = _stack.back();
+      _stack.pop_back();
+      auto l = _stack.back();
+      _stack.back() = pos;
+
+      changed = changed || _dirty[l] || _dirty[r] || _left[pos] != l;
+      if(changed) {
+        _left[pos] = l;
+        _combine(_curve(l), _curve(r), _expr[pos], _curves[pos]);
+      }
+    }
+    _dirty[pos] = changed;
+  }
+
+  _dirty_lo = _expr.size();
+  _dirty_hi = 0;
+}
+
+// Stockmeyer: side by side the widths add and the taller point is replaced
+// by the next narrower-but-shorter one, stacked the same with the roles of
+// width and height exchanged. O(|a| + |b|).
+void Slicing::_combine(
+  const std::vector<Shape>& a,
+  const std::vector<Shape>& b,
+  size_t op,
+  std::vector<Shape>& curve
+) {
+  curve.clear();
+
+  if(op == _v) {
+    size_t i{0};
+    size_t j{0};
+    while(i < a.size() && j < b.size()) {
+      Shape s{a[i].w + b[j].w, std::max(a[i].h, b[j].h), i, j};
+      if(curve.empty() || s.h < curve.back().h) {
+        curve.push_back(s);
+      }
+      if(a[i].h > b[j].h) {
+        ++i;
+      }
+      else if(a[i].h < b[j].h) {
+        ++j;
+      }
+      else {
+        ++i;
+        ++j;
+      }
+    }
+  }
+  else {
+    size_t i{a.size()};
+    size_t j{b.size()};
+    while(i > 0 && j > 0) {
+      Shape s{std::max(a[i - 1].w, b[j - 1].w), a[i - 1].h + b[j - 1].h, i - 1, j - 1};
+      if(curve.empty() || s.w < curve.back().w) {
+        curve.push_back(s);
+      }
+      if(a[i - 1].w > b[j - 1].w) {
+        --i;
+      }
+      else if(a[i - 1].w < b[j - 1].w) {
+        --j;
+      }
+      else {
+        --i;
+        --j;
+      }
+    }
+    std::reverse(curve.begin(), curve.end());
+  }
+}
+
+// picks the root shape that overflows the outline least (the smallest one
+// that fits, if any) and hands the chosen points down to the blocks
+void Slicing::_place() {
+
+  auto root = _expr.size() - 1;
+  auto& curve = _curve(root);
+
+  size_t best{0};
+  double best_box{0};
+  double best_area{0};
+  for(size_t k = 0; k < curve.size(); ++k) {
+    double box = static_cast<double>(std::max(curve[k].w, _outline.first)) * std::max(curve[k].h, _outline.second);
+    double area = static_cast<double>(curve[k].w) * curve[k].h;
+    if(k == 0 || box < best_box || (box == best_box && area < best_area)) {
+      best = k;
+      best_box = box;
+      best_area = area;
+    }
+  }
+
+  _chip_width = curve[best].w;
+  _chip_height = curve[best].h;
+  _chip_area = _chip_height * _chip_width;
+
+  // (position, point, x, y)
+  std::vector<std::array<size_t, 4>> stack{{root, best, 0, 0}};
+  while(!stack.empty()) {
+    auto [pos, k, x, y] = stack.back();
+    stack.pop_back();
+
+    auto& s = _curve(pos)[k];
+    if(_expr[pos] > _h) {
+      auto id = _expr[pos];
+      _width[id] = s.w;
+      _height[id] = s.h;
+      _locate(id, x, y);
+    }
+    else {
+      auto l = _left[pos];
+      auto r = pos - 1;
+      auto& ls = _curve(l)[s.l];
+      stack.push_back({l, s.l, x, y});
+      if(_expr[pos] == _v) {
+        stack.push_back({r, s.r, x + ls.w, y});
+      }
+      else {
+        stack.push_back({r, s.r, x, y + ls.h});
+      }
+    }
+  }
+}
+
+// M1 swaps two adjacent operands, M2 complements a chain of operators and M3
+// swaps an adjacent operand and operator while the expression stays
+// normalized (no equal neighboring operators) and valid (more operands than
+// operators in every prefix)
+void Slicing::_move() {
+
+  std::uniform_int_distribution<> random_move(1, 3);
+  std::uniform_int_distribution<size_t> random_pos(0, _expr.size() - 1);
+
+  if(_num_blocks < 2) {
+    _move_range = {0, 0};
+    return;
+  }
+
+  auto random = random_move(_eng);
+
+  if(random == 3) {
+    for(size_t tries = 0; tries < 10; ++tries) {
+      auto pos = random_pos(_eng);
+      if(pos + 1 < _expr.size() && _swap_operand_operator(pos)) {
+        _move_range = {pos, pos + 1};
+        _touch(pos, pos + 1);
+        return;
+      }
+    }
+    random = 1;
+  }
+
+  if(random == 1) {
+    auto pos = random_pos(_eng);
+    while(_expr[pos] <= _h) {
+      --pos;
+    }
+    auto next = pos + 1;
+    while(next < _expr.size() && _expr[next] <= _h) {
+      ++next;
+    }
+    if(next == _expr.size()) {
+      next = pos;
+      do {
+        --pos;
+      } while(_expr[pos] <= _h);
+    }
+    std::swap(_expr[pos], _expr[next]);
+    _move_range = {pos, next};
+  }
+  else {
+    auto pos = random_pos(_eng);
+    while(_expr[pos] > _h) {
+      ++pos;
+    }
+    auto lo = pos;
+    while(lo > 0 && _expr[lo - 1] <= _h) {
+      --lo;
+    }
+    auto hi = pos;
+    while(hi + 1 < _expr.size() && _expr[hi + 1] <= _h) {
+      ++hi;
+    }
+    for(auto i = lo; i <= hi; ++i) {
+      _expr[i] = _expr[i] == _v ? _h : _v;
+    }
+    _move_range = {lo, hi};
+  }
+
+  _touch(_move_range.first, _move_range.second);
+}
+
+bool Slicing::_swap_operand_operator(size_t pos) {
+
+  bool operand_first = _expr[pos] > _h;
+  if(operand_first == (_expr[pos + 1] > _h)) {
+    return false;
+  }
+
+  std::swap(_expr[pos], _expr[pos + 1]);
+
+  // the operator now at pos (or pos + 1) must differ from its neighbors
+  auto op = operand_first ? pos : pos + 1;
+  bool valid = (op == 0 || _expr[op - 1] != _expr[op]) &&
+               (op + 1 == _expr.size() || _expr[op + 1] != _expr[op]);
+
+  // an operator moving left needs more operands than operators before it
+  if(valid && operand_first) {
+    size_t operators{0};
+    for(size_t i = 0; i <= pos; ++i) {
+      operators += _expr[i] <= _h;
+    }
+    valid = 2 * operators < pos + 1;
+  }
+
+  if(!valid) {
+    std::swap(_expr[pos], _expr[pos + 1]);
+  }
+  return valid;
+}
+
+void Slicing::_touch(size_t lo, size_t hi) {
+  _dirty_lo = std::min(_dirty_lo, lo);
+  _dirty_hi = std::max(_dirty_hi, hi);
+}
+
+void Slicing::_touch_all() {
+  _dirty_lo = 0;
+  _dirty_hi = _expr.size();
+}
+
+void Slicing::_accept() {
+  _prev_expr = _expr;
+  _prev_cost = _cost;
+}
+
+// the curves of the restored positions are stale until the next evaluation
+void Slicing::_reject() {
+  _expr = _prev_expr;
+  _cost = _prev_cost;
+  _touch(_move_range.first, _move_range.second);
+}
+
+void Slicing::_update_best() {
+  _best_expr = _expr;
+  _best_cost = _cost;
+}
+
+void Slicing::_update_all_to_best() {
+  _expr = _best_expr;
+  _cost = _best_cost;
+
+  _prev_expr = _best_expr;
+  _prev_cost = _best_cost;
+  _touch_all();
+}
+
+// restart from the best solution of another annealer
+void Slicing::_adopt_best(const Slicing& sl) {
+  _adopt(sl._snapshot());
+}
+
+Slicing::Snapshot Slicing::_snapshot() const {
+  return {_best_expr, _best_cost};
+}
+
+void Slicing::_adopt(const Snapshot& snapshot) {
+  _best_expr = snapshot.expr;
+  _best_cost = snapshot.cost;
+  _cost = snapshot.cost;
+
+  _update_all_to_best();
+}
+
+} // end of namespace ===================================================
@@ -4,20 +4,23 @@
 #include <src/block.hpp>
 #include <src/terminal.hpp>
 #include <src/net.hpp>
+#include <src/floorplan.hpp>
 
 namespace fp { // begin of namespace ====================================
 
-class SP {
+class SP : public Floorplan {
 
-  friend class ParallelSP;
+  template <typename T> friend class Parallel;
 
   public:
 
+    static constexpr const char* title{"Sequence-pair Placement"};
+
     SP(
       const float alpha,
       const std::filesystem::path& blockf, 
       const std::filesystem::path& netf,
-      std::mt19937& eng
+      std::mt19937 eng
     );
 
     SP(const SP& sp) = default;
@@ -28,64 +31,53 @@ class SP {
   
     ~SP() = default;
 
-    void apply();
-    void dump(std::ostream& os);
-
   private:
 
-    void _parse_block(
-      const std::filesystem::path& blockf
-    );
-
-    void _parse_net(
-      const std::filesystem::path& netf
-    );
-
     void _initialize();
     void _build_connections();
     void _spfa_h();
     void _spfa_v();
+    void _pack();
+    void _touch(size_t id);
+    void _touch_all();
+    void _check();
+    size_t _bit_query(size_t pos) const;
+    void _bit_update(size_t pos, size_t value);
+    void _bit_build();
     void _move();
     void _move1(size_t idx1);
     void _move2(size_t idx1);
     void _move3(size_t idx);
     void _move(const std::vector<Block*>& out_bounds);
     void _get_results();
-    void _get_final_results();
-    void _update_average();
     void _set_coordinate();
     void _set_wirelength();
     void _reject();
     void _accept();
     void _update_best();
     void _update_all_to_best();
+    void _adopt_best(const SP& sp);
+
+    // the best solution, never changed once taken
+    struct Snapshot {
+      std::vector<size_t> first_seq;
+      std::vector<size_t> second_seq;
+      std::vector<size_t> first_seq_id_loc_map;
+      std::vector<size_t> second_seq_id_loc_map;
+      std::vector<uint32_t> width;
+      std::vector<uint32_t> height;
+      double cost;
+    };
+
+    Snapshot _snapshot() const;
+    void _adopt(const Snapshot& snapshot);
     void _reverse();
-    void _compress(int step_size);
-    void _detail_compress();
-    bool _is_overlapped(Block* a, Block* b);
-    double _get_penalty();
-
-    std::unordered_map<std::string, Block> _blocks_map;
-    std::vector<Block*> _blocks;
-
-    std::unordered_map<std::string, Terminal> _terminals_map;
-    std::vector<Net> _nets;
-
-    std::pair<size_t, size_t> _outline;
-    size_t _num_blocks;
-    size_t _num_nets;
-    size_t _num_terminals;
 
     std::vector<size_t> _first_seq;
     std::vector<size_t> _second_seq;
     std::vector<size_t> _first_seq_id_loc_map;
     std::vector<size_t> _second_seq_id_loc_map;
-    double _cost;
 
-    std::vector<size_t> _prev_first_seq;
-    std::vector<size_t> _prev_second_seq;
-    std::vector<size_t> _prev_first_seq_id_loc_map;
-    std::vector<size_t> _prev_second_seq_id_loc_map;
     double _prev_cost;
 
     std::vector<size_t> _best_first_seq;
@@ -94,34 +86,46 @@ class SP {
     std::vector<size_t> _best_second_seq_id_loc_map;
     double _best_cost;
 
-    std::vector<std::pair<size_t, size_t>> _best_block_wh;
-    std::vector<std::pair<size_t, size_t>> _prev_block_wh;
+    std::vector<uint32_t> _best_width;
+    std::vector<uint32_t> _best_height;
 
-    std::vector<size_t> _length_h;
-    std::vector<size_t> _length_v;
+    std::vector<uint32_t> _length_h;
+    std::vector<uint32_t> _length_v;
 
     std::vector<size_t> _critical_path_h;
     std::vector<size_t> _critical_path_v;
 
-    Block* _s;
-    Block* _t;
-
-    float _wire_length;
-    float _chip_area;
-    float _chip_height;
-    float _chip_width;
-    float _alpha;
-
-    size_t _iter{1};
-
-    double _area_average{0};
-    double _wire_length_average{0};
-    double _penalty_average{0};
-
-    std::mt19937& _eng;
-    std::chrono::time_point<std::chrono::steady_clock> _tic;
-    std::chrono::time_point<std::chrono::steady_clock> _toc;
-    float _runtime;
+    // Fenwick tree of prefix maxima over second-sequence positions (FAST-SP)
+    std::vector<size_t> _bit;
+
+    // incremental evaluation: x is recomputed for first-sequence positions
+    // from _dirty_lo on, y up to _dirty_hi (clean if _dirty_lo == _num_blocks).
+    // _touched are the blocks changed since the last evaluation and _moved
+    // the blocks whose coordinates changed in the last evaluation.
+    size_t _dirty_lo{0};
+    size_t _dirty_hi{0};
+    std::vector<size_t> _touched;
+    std::vector<size_t> _moved;
+    std::vector<char> _is_moved;
+
+    // a perturbation of _move, enough to take it back: the two blocks swapped
+    // in the first and/or the second sequence, or the block rotated and its
+    // width and height before
+    struct Undo {
+      bool first;
+      bool second;
+      size_t id1;
+      size_t id2;
+      uint32_t width;
+      uint32_t height;
+    };
+
+    // moves and packing changes since the last accept; a reject replays them
+    // backwards instead of copying the accepted state back
+    std::vector<Undo> _undo;
+    std::vector<std::pair<size_t, size_t>> _undo_length_h;
+    std::vector<std::pair<size_t, size_t>> _undo_length_v;
+    bool _length_undoable{false};
 
 };
 
@@ -129,37 +133,10 @@ SP::SP(
   const float alpha,
   const std::filesystem::path& blockf, 
   const std::filesystem::path& netf,
-  std::mt19937& eng
-):_alpha{alpha}, _eng{eng} {
-  _tic = std::chrono::steady_clock::now();
-  // source
-  auto src = _blocks_map.emplace(
-    std::piecewise_construct, 
-    std::forward_as_tuple("src"), 
-    std::forward_as_tuple("src", 0, 0, 0)
-  );
-  auto& src_ = (*(src.first)).second;
-  _blocks.push_back(&src_);
-  _s = _blocks[0];
-
-  // target
-  auto tgt = _blocks_map.emplace(
-    std::piecewise_construct, 
-    std::forward_as_tuple("tgt"),
-    std::forward_as_tuple("tgt", 1, 0, 0)
-  );
-  auto& tgt_ = (*(tgt.first)).second;
-  _blocks.push_back(&tgt_);
-  _t = _blocks[1];
-
-  _parse_block(blockf);
-  _parse_net(netf);
-
-  _best_block_wh.resize(_blocks.size());
-  _prev_block_wh.resize(_blocks.size());
-
-
+  std::mt19937 eng
+): Floorplan(alpha, blockf, netf, std::move(eng)) {
 
+  _is_moved.resize(_blocks.size(), false);
 
   _initialize();
   _update_average();
@@ -169,98 +146,6 @@ SP::SP(
   _update_all_to_best();
 }
 
-void SP::_update_average() {
-
-  _area_average *= _iter;
-  _wire_length_average *= _iter;
-  _penalty_average *= _iter;
-
-  _area_average += _chip_area;
-  _wire_length_average += _wire_length;
-  _penalty_average += _get_penalty();
-
-  _area_average /= (_iter + 1);
-  _wire_length_average /= (_iter + 1);
-  _penalty_average /= (_iter + 1);
-
-  ++_iter;
-}
-
-double SP::_get_penalty() {
-  double penalty{0};
-  for(size_t i = 2; i < _num_blocks + 2; ++i) {
-
-    if(_outline.first < _blocks[i]->_x2) {
-      penalty += std::pow(_blocks[i]->_x2 - _outline.first, 2);
-  
-    } 
-
-    if(_outline.second < _blocks[i]->_y2) {
-      penalty += std::pow(_blocks[i]->_y2 - _outline.second, 2);
-    }
-  }
-
-  if(_chip_width > _outline.first && _chip_height < _outline.second ) {
-    penalty += (_chip_width - _outline.first) * _outline.second;
-   }
-  else if(_chip_width < _outline.first && _chip_height > _outline.second) {
-    penalty += (_chip_height - _outline.second) * _outline.first;
-  }
-  else if (_chip_width > _outline.first && _chip_height > _outline.second) {
-    penalty += _chip_height * _chip_width - _outline.second * _outline.first;
-  }
-  return std::sqrt(penalty);
-}
-
-
-void SP::apply() {
-
-  std::uniform_real_distribution dist(0.f, 1.f);
-  std::uniform_int_distribution<size_t> dist2(1, 10);
-
-  size_t count{0};
-  std::vector<Block*> out_bounds;
-  std::vector<Block*> in_bounds;
-  double temp{5000};
-
-  double beta = 1000;
-  while(temp > 5) {
-
-    for(size_t i = 0; i < 3000; ++i) {
-      _move();
-
-      _build_connections();
-      _get_results();
-
-      double penalty = _get_penalty() / _penalty_average;
-      _cost = penalty;
-      if(_cost < _prev_cost) {
-        _accept();
-        if(_cost < _best_cost) {
-          _update_best();
-          _update_average();
-        }
-      }
-      else {
-        auto random = dist(_eng);
-        double accr = std::exp((_cost - _prev_cost) * beta * -1 / temp);
-
-        if(accr > random) {
-          _accept();
-        }
-        else {
-          _reject();
-        }
-      }
-    }
-    temp *= 0.85;
-  }
-
-  _update_all_to_best();
-  _build_connections();
-  _get_results();
-}
-
 void SP::_update_all_to_best() {
   _first_seq = _best_first_seq;
   _second_seq = _best_second_seq;
@@ -268,17 +153,45 @@ void SP::_update_all_to_best() {
   _second_seq_id_loc_map = _best_second_seq_id_loc_map;
   _cost = _best_cost;
 
-  _prev_first_seq = _best_first_seq;
-  _prev_second_seq = _best_second_seq;
-  _prev_first_seq_id_loc_map = _best_first_seq_id_loc_map;
-  _prev_second_seq_id_loc_map = _best_second_seq_id_loc_map;
   _prev_cost = _best_cost;
 
-  for(size_t i = 2; i < _num_blocks + 2; ++i) {
-    _blocks[i]->_width       = _best_block_wh[i].first;
-    _blocks[i]->_height      = _best_block_wh[i].second;
-  }
-  _prev_block_wh  = _best_block_wh;
+  _width = _best_width;
+  _height = _best_height;
+  _undo.clear();
+  _undo_length_h.clear();
+  _undo_length_v.clear();
+  _length_undoable = false;
+  _touch_all();
+}
+
+// restart from the best solution of another annealer
+void SP::_adopt_best(const SP& sp) {
+  _adopt(sp._snapshot());
+}
+
+SP::Snapshot SP::_snapshot() const {
+  return {
+    _best_first_seq,
+    _best_second_seq,
+    _best_first_seq_id_loc_map,
+    _best_second_seq_id_loc_map,
+    _best_width,
+    _best_height,
+    _best_cost
+  };
+}
+
+void SP::_adopt(const Snapshot& snapshot) {
+  _best_first_seq = snapshot.first_seq;
+  _best_second_seq = snapshot.second_seq;
+  _best_first_seq_id_loc_map = snapshot.first_seq_id_loc_map;
+  _best_second_seq_id_loc_map = snapshot.second_seq_id_loc_map;
+  _best_width = snapshot.width;
+  _best_height = snapshot.height;
+  _best_cost = snapshot.cost;
+  _cost = snapshot.cost;
+
+  _update_all_to_best();
 }
 
 void SP::_update_best() {
@@ -287,56 +200,63 @@ void SP::_update_best() {
   _best_first_seq_id_loc_map = _first_seq_id_loc_map;
   _best_second_seq_id_loc_map = _second_seq_id_loc_map;
   _best_cost = _cost;
-
-  for(size_t i = 2; i < _num_blocks + 2; ++i) {
-    _best_block_wh[i].first  = _blocks[i]->_width;
-    _best_block_wh[i].second = _blocks[i]->_height;
-  }
+  _best_width = _width;
+  _best_height = _height;
 }
 
 void SP::_accept() {
-  _prev_first_seq = _first_seq;
-  _prev_second_seq = _second_seq;
-  _prev_first_seq_id_loc_map = _first_seq_id_loc_map;
-  _prev_second_seq_id_loc_map = _second_seq_id_loc_map;
   _prev_cost = _cost;
 
-  for(size_t i = 2; i < _num_blocks + 2; ++i) {
-    _prev_block_wh[i].first  = _blocks[i]->_width;
-    _prev_block_wh[i].second = _blocks[i]->_height;
-  }
+  _undo.clear();
+  _undo_length_h.clear();
+  _undo_length_v.clear();
+  _length_undoable = _dirty_lo == _num_blocks;
 }
 
 void SP::_reject() {
-  _first_seq = _prev_first_seq;
-  _second_seq = _prev_second_seq;
-  _first_seq_id_loc_map = _prev_first_seq_id_loc_map;
-  _second_seq_id_loc_map = _prev_second_seq_id_loc_map;
   _cost = _prev_cost;
 
-  for(size_t i = 2; i < _num_blocks + 2; ++i) {
-    _blocks[i]->_width  = _prev_block_wh[i].first;
-    _blocks[i]->_height = _prev_block_wh[i].second;
+  for(auto it = _undo.rbegin(); it != _undo.rend(); ++it) {
+    auto& u = *it;
+    if(u.first) {
+      std::swap(_first_seq[_first_seq_id_loc_map[u.id1]], _first_seq[_first_seq_id_loc_map[u.id2]]);
+      std::swap(_first_seq_id_loc_map[u.id1], _first_seq_id_loc_map[u.id2]);
+    }
+    if(u.second) {
+      std::swap(_second_seq[_second_seq_id_loc_map[u.id1]], _second_seq[_second_seq_id_loc_map[u.id2]]);
+      std::swap(_second_seq_id_loc_map[u.id1], _second_seq_id_loc_map[u.id2]);
+    }
+    if(!u.first && !u.second) {
+      _width[u.id1] = u.width;
+      _height[u.id1] = u.height;
+    }
   }
-}
-
-
-void SP::dump(std::ostream& os) {
-
-  _toc = std::chrono::steady_clock::now();
-  _runtime = std::chrono::duration_cast<std::chrono::seconds>(_toc - _tic).count();
-
-  os << _cost        << "\n";
-  os << _wire_length << "\n";
-  os << _chip_area   << "\n";
-  os << _chip_width  << " "   << _chip_height << "\n";
-  os << _runtime     << "\n";
 
-  for(size_t i = 2; i < _num_blocks + 2; ++i) {
-    os << _blocks[i]->_name << " " << _blocks[i]->_x1 << " " << _blocks[i]->_y1 << " " << _blocks[i]->_x2 << " " << _blocks[i]->_y2 << "\n";
+  // the accepted packing is restored as is, only the blocks the rejected
+  // evaluation moved need their coordinates and nets again
+  if(_length_undoable && _dirty_lo == _num_blocks) {
+    for(auto it = _undo_length_h.rbegin(); it != _undo_length_h.rend(); ++it) {
+      _length_h[it->first] = it->second;
+    }
+    for(auto it = _undo_length_v.rbegin(); it != _undo_length_v.rend(); ++it) {
+      _length_v[it->first] = it->second;
+    }
+    _touched.insert(_touched.end(), _moved.begin(), _moved.end());
   }
+  else {
+    for(auto& u: _undo) {
+      _touch(u.id1);
+      _touch(u.id2);
+    }
+    _length_undoable = false;
+  }
+
+  _undo.clear();
+  _undo_length_h.clear();
+  _undo_length_v.clear();
 }
 
+
 void SP::_initialize() {
   _first_seq.clear();
   _second_seq.clear();
@@ -364,13 +284,12 @@ void SP::_initialize() {
     _second_seq_id_loc_map[s] = i;
   }
 
-  _build_connections();
+  _touch_all();
   _get_results();
 }
 
 void SP::_get_results() {
-  _spfa_h();
-  _spfa_v();
+  _pack();
 
   _set_coordinate();
   _chip_width = _length_h[1];
@@ -379,160 +298,79 @@ void SP::_get_results() {
 
   //_cost = _alpha * _chip_area / _area_average + (1-_alpha) * _wire_length / _wire_length_average;
   _set_wirelength();
+
+#ifdef SP_CHECK
+  _check();
+#endif
 }
 
+// debug cross-check (cmake -DSP_CHECK=ON): the incremental evaluation must
+// match a full FAST-SP evaluation and the constraint-graph longest paths
+void SP::_check() {
+  auto length_h = _length_h;
+  auto length_v = _length_v;
+  auto wire_length2 = _wire_length2;
+  auto coords = std::array{_x1, _y1, _x2, _y2};
+
+  // the full re-pack below would leave the reject to re-pack as well, so the
+  // undo state of the incremental evaluation is put back afterwards
+  auto moved = _moved;
+  auto is_moved = _is_moved;
+  auto undo_length_h = _undo_length_h;
+  auto undo_length_v = _undo_length_v;
+  auto length_undoable = _length_undoable;
 
-void SP::_get_final_results() {
+  _build_connections();
   _spfa_h();
   _spfa_v();
+  if(_length_h != length_h || _length_v != length_v) {
+    throw std::runtime_error("incremental packing differs from the constraint graphs");
+  }
 
+  _touch_all();
+  _pack();
   _set_coordinate();
-  _compress(1);
-  _set_wirelength();
-  _chip_width = (*std::max_element(_blocks.begin() + 2, _blocks.end(), [](const Block* a, const Block* b){ return a->_x2 < b->_x2; }))->_x2;
-  _chip_height = (*std::max_element(_blocks.begin() + 2, _blocks.end(), [](const Block* a, const Block* b){ return a->_y2 < b->_y2; }))->_y2;
-  _chip_area = _chip_height * _chip_width;
-  _chip_width = (*std::max_element(_blocks.begin() + 2, _blocks.end(), [](const Block* a, const Block* b){ return a->_x2 < b->_x2; }))->_x2;
-  _chip_height = (*std::max_element(_blocks.begin() + 2, _blocks.end(), [](const Block* a, const Block* b){ return a->_y2 < b->_y2; }))->_y2;
-  _chip_area = _chip_height * _chip_width;
-}
-
-void SP::_compress(int step_size) {
-
-  size_t count = 10;
-  while(count-- > 0) {
-    std::vector<size_t> sorted_idx_x(_num_blocks);
-    std::iota(sorted_idx_x.begin(), sorted_idx_x.end(), 2);
-    std::stable_sort(sorted_idx_x.begin(), sorted_idx_x.end(), [this](const size_t a, const size_t b) {
-      return _blocks[a]->_x1 < _blocks[b]->_x1;
-    });
-
-    std::vector<size_t> sorted_idx_y(_num_blocks);
-    std::iota(sorted_idx_y.begin(), sorted_idx_y.end(), 2);
-    std::stable_sort(sorted_idx_y.begin(), sorted_idx_y.end(), [this](const size_t a, const size_t b) {
-      return _blocks[a]->_y1 < _blocks[b]->_y1;
-    });
-
-    // horizonal
-    for(int i = 0; i < sorted_idx_x.size(); ++i) {
-      auto idx = sorted_idx_x[i];
-      int from = _blocks[idx]->_x1;
-      for(int x = from - step_size; x > 0; x-=step_size) {
-        size_t prev_x1 = _blocks[idx]->_x1;
-        size_t prev_y1 = _blocks[idx]->_y1;
-        size_t prev_x2 = _blocks[idx]->_x2;
-        size_t prev_y2 = _blocks[idx]->_y2;
-        bool is_legal = true;
-        _blocks[idx]->_x1 = x;
-        _blocks[idx]->_x2 = _blocks[idx]->_x1 + _blocks[idx]->_width;
-        
-        for(size_t k = 2; k < _num_blocks + 2; ++k) {
-          if(k != idx && _is_overlapped(_blocks[idx], _blocks[k])) {
-            is_legal = false;
-            break;
-          }
-        }
-        if(!is_legal) {
-          _blocks[idx]->set_coordinate(prev_x1, prev_y1, prev_x2, prev_y2);
-          break;
-        }
-      }
-    }
-
-    // vertical
-    for(int i = 0; i < sorted_idx_y.size(); ++i) {
-      auto idx = sorted_idx_y[i];
-      int from = _blocks[idx]->_y1;
-      for(int y = from - step_size; y > 0; y-=step_size) {
-        size_t prev_x1 = _blocks[idx]->_x1;
-        size_t prev_y1 = _blocks[idx]->_y1;
-        size_t prev_x2 = _blocks[idx]->_x2;
-        size_t prev_y2 = _blocks[idx]->_y2;
-        bool is_legal = true;
-        _blocks[idx]->_y1 = y;
-        _blocks[idx]->_y2 = _blocks[idx]->_y1 + _blocks[idx]->_height;
-        
-        for(size_t k = 2; k < _num_blocks + 2; ++k) {
-          if(k != idx && _is_overlapped(_blocks[idx], _blocks[k])) {
-            is_legal = false;
-            break;
-          }
-        }
-        if(!is_legal) {
-          _blocks[idx]->set_coordinate(prev_x1, prev_y1, prev_x2, prev_y2);
-          break;
-        }
-      }
+  _sweep_wirelength();
+  for(size_t i = 0; i < _blocks.size(); ++i) {
+    if(std::array{coords[0][i], coords[1][i], coords[2][i], coords[3][i]} != std::array{_x1[i], _y1[i], _x2[i], _y2[i]}) {
+      throw std::runtime_error("incremental coordinates of " + _blocks[i]->_name + " differ from full evaluation");
     }
   }
-}
+  if(_length_h != length_h || _length_v != length_v || _wire_length2 != wire_length2) {
+    throw std::runtime_error("incremental evaluation differs from full evaluation");
+  }
 
-bool SP::_is_overlapped(Block* a, Block* b) {
-  return 
-    !(a->_x2 <= b->_x1 || a->_x1 >= b->_x2 || a->_y2 <= b->_y1 || a->_y1 >= b->_y2);
+  _moved = std::move(moved);
+  _is_moved = std::move(is_moved);
+  _undo_length_h = std::move(undo_length_h);
+  _undo_length_v = std::move(undo_length_v);
+  _length_undoable = length_undoable;
 }
 
+
+// only the blocks _pack moved; all of them after a full packing
 void SP::_set_coordinate() {
 
-  for(size_t i = 0; i < _num_blocks + 2; ++i) {
-    _blocks[i]->set_coordinate(_length_h[i] - _blocks[i]->_width, _length_v[i] - _blocks[i]->_height, _length_h[i], _length_v[i]);
+  if(_moved.size() == _blocks.size()) {
+    _x2 = _length_h;
+    _y2 = _length_v;
+    sub_u32(_length_h.data(), _width.data(), _x1.data(), _blocks.size());
+    sub_u32(_length_v.data(), _height.data(), _y1.data(), _blocks.size());
+    return;
+  }
+
+  for(auto i: _moved) {
+    _locate(i, _length_h[i] - _width[i], _length_v[i] - _height[i]);
   }
 }
 
+// only the nets on blocks _pack moved
 void SP::_set_wirelength() {
-  
-  _wire_length = 0.;
-  for(auto& n: _nets) {
-    float lg;
-    size_t bx_min{INT_MAX};
-    size_t bx_max{0};
-    size_t by_min{INT_MAX};
-    size_t by_max{0};
-    for(auto b: n._blocks) {
-      auto tmpx = 2 * b->_x1 + b->_width;
-      auto tmpy = 2 * b->_y1 + b->_height;
-      bx_min = std::min(tmpx, bx_min);
-      bx_max = std::max(tmpx, bx_max);
-
-      by_min = std::min(tmpy, by_min);
-      by_max = std::max(tmpy, by_max);
-    }
-
-    if(!n._terminals.empty()) {
-      size_t tx_min{INT_MAX};
-      size_t tx_max{0};
-      size_t ty_min{INT_MAX};
-      size_t ty_max{0};
-      for(auto t: n._terminals) {
-        auto tmpx = 2 * t->_x;
-        auto tmpy = 2 * t->_y;
-        tx_min = std::min(tmpx, tx_min);
-        tx_max = std::max(tmpx, tx_max);
-
-        ty_min = std::min(tmpy, ty_min);
-        ty_max = std::max(tmpy, ty_max);
-      }
-
-      size_t x_min = std::min(bx_min, tx_min);
-      size_t x_max = std::max(bx_max, tx_max);
-      size_t y_min = std::min(by_min, ty_min);
-      size_t y_max = std::max(by_max, ty_max);
-      lg = (x_max - x_min + y_max - y_min) / 2.0f;
-    }
-    //else {
-      size_t x_min = bx_min;
-      size_t x_max = bx_max;
-      size_t y_min = by_min;
-      size_t y_max = by_max;
-      lg = (x_max - x_min + y_max - y_min) / 2.0f;
-    //}
-
-    n.set_length(lg);
-    _wire_length += lg;
-  }
-  _wire_length;
+  Floorplan::_set_wirelength(_moved);
 }
 
+// constraint graphs of the sequence pair, O(n^2) edges. the annealer packs
+// with _pack instead, the graphs are kept as the reference evaluation.
 void SP::_build_connections() {
 
   for(auto& b: _blocks) {
@@ -591,8 +429,8 @@ void SP::_spfa_h() {
     in_queue[b->_id] = false;
 
     for(auto nb: b->_hconnects) {
-      if(_length_h[b->_id] + nb->_width > _length_h[nb->_id]) {
-        _length_h[nb->_id] = _length_h[b->_id] + nb->_width;
+      if(_length_h[b->_id] + _width[nb->_id] > _length_h[nb->_id]) {
+        _length_h[nb->_id] = _length_h[b->_id] + _width[nb->_id];
         if(!in_queue[nb->_id]) {
           in_queue[nb->_id] = true;
           spfa.push(nb);
@@ -618,8 +456,8 @@ void SP::_spfa_v() {
     in_queue[b->_id] = false;
 
     for(auto nb: b->_vconnects) {
-      if(_length_v[b->_id] + nb->_height > _length_v[nb->_id]) {
-        _length_v[nb->_id] = _length_v[b->_id] + nb->_height;
+      if(_length_v[b->_id] + _height[nb->_id] > _length_v[nb->_id]) {
+        _length_v[nb->_id] = _length_v[b->_id] + _height[nb->_id];
         if(!in_queue[nb->_id]) {
           in_queue[nb->_id] = true;
           spfa.push(nb);
@@ -630,6 +468,134 @@ void SP::_spfa_v() {
 
 }
 
+// FAST-SP (Tang & Wong): the packing of a sequence pair is a weighted longest
+// common subsequence. a is left of b iff a is before b in both sequences, so
+// walking the first sequence, the x of a block is the largest right edge among
+// the blocks seen so far at smaller second-sequence positions, a prefix
+// maximum kept in a Fenwick tree. a is below b iff a is after b in the first
+// sequence and before b in the second, which is the same walk over the
+// reversed first sequence. O(n log n) and no edge lists; _length_h/_length_v
+// hold the same right/top edges as the longest paths of _spfa_h/_spfa_v.
+void SP::_pack() {
+
+  for(auto i: _moved) {
+    _is_moved[i] = false;
+  }
+  _moved.clear();
+
+  auto mark = [this](size_t id) {
+    if(!_is_moved[id]) {
+      _is_moved[id] = true;
+      _moved.push_back(id);
+    }
+  };
+
+  if(_dirty_lo == _num_blocks) {
+    return;
+  }
+
+  // everything is re-packed and every block counts as moved
+  if(_length_h.size() != _num_blocks + 2 || (_dirty_lo == 0 && _dirty_hi + 1 == _num_blocks)) {
+    _length_h.assign(_num_blocks + 2, 0);
+    _length_v.assign(_num_blocks + 2, 0);
+    _dirty_lo = 0;
+    _dirty_hi = _num_blocks - 1;
+    _length_undoable = false;
+    for(size_t i = 0; i < _num_blocks + 2; ++i) {
+      mark(i);
+    }
+  }
+
+  // blocks before _dirty_lo keep their x, the tree starts from them in O(n)
+  _bit.assign(_num_blocks + 1, 0);
+  for(size_t i = 0; i < _dirty_lo; ++i) {
+    auto id = _first_seq[i];
+    _bit[_second_seq_id_loc_map[id] + 1] = _length_h[id];
+  }
+  _bit_build();
+  for(size_t i = _dirty_lo; i < _num_blocks; ++i) {
+    auto id = _first_seq[i];
+    auto pos = _second_seq_id_loc_map[id];
+    auto length = _bit_query(pos) + _width[id];
+    if(length != _length_h[id]) {
+      _undo_length_h.emplace_back(id, _length_h[id]);
+      _length_h[id] = length;
+      mark(id);
+    }
+    _bit_update(pos, length);
+  }
+  _undo_length_h.emplace_back(1, _length_h[1]);
+  _length_h[1] = _bit_query(_num_blocks);
+
+  // blocks after _dirty_hi keep their y
+  _bit.assign(_num_blocks + 1, 0);
+  for(size_t i = _dirty_hi + 1; i < _num_blocks; ++i) {
+    auto id = _first_seq[i];
+    _bit[_second_seq_id_loc_map[id] + 1] = _length_v[id];
+  }
+  _bit_build();
+  for(size_t i = _dirty_hi + 1; i-- > 0;) {
+    auto id = _first_seq[i];
+    auto pos = _second_seq_id_loc_map[id];
+    auto length = _bit_query(pos) + _height[id];
+    if(length != _length_v[id]) {
+      _undo_length_v.emplace_back(id, _length_v[id]);
+      _length_v[id] = length;
+      mark(id);
+    }
+    _bit_update(pos, length);
+  }
+  _undo_length_v.emplace_back(1, _length_v[1]);
+  _length_v[1] = _bit_query(_num_blocks);
+  mark(1);
+
+  // a rotated block may keep its right/top edge
+  for(auto id: _touched) {
+    mark(id);
+  }
+  _touched.clear();
+
+  _dirty_lo = _num_blocks;
+  _dirty_hi = 0;
+}
+
+void SP::_touch(size_t id) {
+  _touched.push_back(id);
+  auto pos = _first_seq_id_loc_map[id];
+  _dirty_lo = std::min(_dirty_lo, pos);
+  _dirty_hi = std::max(_dirty_hi, pos);
+}
+
+void SP::_touch_all() {
+  _dirty_lo = 0;
+  _dirty_hi = _num_blocks - 1;
+}
+
+// maximum over positions [0, pos)
+size_t SP::_bit_query(size_t pos) const {
+  size_t value{0};
+  for(; pos > 0; pos -= pos & (~pos + 1)) {
+    value = std::max(value, _bit[pos]);
+  }
+  return value;
+}
+
+// prefix maxima of the values stored at _bit[pos + 1], in O(n)
+void SP::_bit_build() {
+  for(size_t i = 1; i <= _num_blocks; ++i) {
+    auto parent = i + (i & (~i + 1));
+    if(parent <= _num_blocks) {
+      _bit[parent] = std::max(_bit[parent], _bit[i]);
+    }
+  }
+}
+
+void SP::_bit_update(size_t pos, size_t value) {
+  for(++pos; pos <= _num_blocks; pos += pos & (~pos + 1)) {
+    _bit[pos] = std::max(_bit[pos], value);
+  }
+}
+
 void SP::_move() {
 
   std::uniform_int_distribution<> random_move(1, 3);
@@ -645,6 +611,7 @@ void SP::_move() {
 
     std::swap(_first_seq[loc1], _first_seq[loc2]);
     std::swap(_first_seq_id_loc_map[idx1], _first_seq_id_loc_map[idx2]);
+    _undo.push_back({true, false, static_cast<size_t>(idx1), static_cast<size_t>(idx2), 0, 0});
   }
   else if(random == 2) {
     // move 2
@@ -661,28 +628,34 @@ void SP::_move() {
     std::swap(_second_seq[second_loc1], _second_seq[second_loc2]);
     std::swap(_first_seq_id_loc_map[idx1], _first_seq_id_loc_map[idx2]);
     std::swap(_second_seq_id_loc_map[idx1], _second_seq_id_loc_map[idx2]);
+    _undo.push_back({true, true, static_cast<size_t>(idx1), static_cast<size_t>(idx2), 0, 0});
   }
   else {
     // move 3
     auto idx = random_idx(_eng);
-    auto* b = _blocks[idx];
+    auto& width = _width[idx];
+    auto& height = _height[idx];
+    _undo.push_back({false, false, static_cast<size_t>(idx), static_cast<size_t>(idx), width, height});
     if(_outline.first < _chip_width && _outline.second < _chip_height) {
-      std::swap(b->_height, b->_width);
+      std::swap(height, width);
     }
     else if(_outline.first < _chip_width) {
-      if(b->_height < b->_width) {
-        std::swap(b->_height, b->_width);
+      if(height < width) {
+        std::swap(height, width);
       }
     } 
     else if(_outline.second < _chip_height) {
-      if(b->_height > b->_width) {
-        std::swap(b->_height, b->_width);
+      if(height > width) {
+        std::swap(height, width);
       }
     }
     else {
-      std::swap(b->_height, b->_width);
+      std::swap(height, width);
     }
   }
+
+  _touch(_undo.back().id1);
+  _touch(_undo.back().id2);
 }
 void SP::_move(const std::vector<Block*>& out_bounds) {
 
@@ -703,6 +676,7 @@ void SP::_move(const std::vector<Block*>& out_bounds) {
 
       std::swap(_first_seq[loc1], _first_seq[loc2]);
       std::swap(_first_seq_id_loc_map[idx1], _first_seq_id_loc_map[idx2]);
+      _undo.push_back({true, false, static_cast<size_t>(idx1), idx2, 0, 0});
       
       break;
     }
@@ -722,6 +696,7 @@ void SP::_move(const std::vector<Block*>& out_bounds) {
       std::swap(_second_seq[second_loc1], _second_seq[second_loc2]);
       std::swap(_first_seq_id_loc_map[idx1], _first_seq_id_loc_map[idx2]);
       std::swap(_second_seq_id_loc_map[idx1], _second_seq_id_loc_map[idx2]);
+      _undo.push_back({true, true, static_cast<size_t>(idx1), idx2, 0, 0});
 
       break;
     }
@@ -730,7 +705,9 @@ void SP::_move(const std::vector<Block*>& out_bounds) {
       // move 3
       auto ob_idx = random_out_bounds(_eng);
       auto idx = out_bounds[ob_idx]->_id;
-      auto* b = _blocks[idx];
+      auto& width = _width[idx];
+      auto& height = _height[idx];
+      _undo.push_back({false, false, idx, idx, width, height});
       //if(_outline.first < b->_x2 && b->_height < b->_width) {
         //std::swap(b->_height, b->_width);
       //}
@@ -741,24 +718,24 @@ void SP::_move(const std::vector<Block*>& out_bounds) {
         auto delta_w = _chip_width - _outline.first;
         auto delta_h = _chip_height - _outline.second;
         if(
-          (delta_w > delta_h && b->_height > b->_width) ||
-          (delta_w < delta_h && b->_height < b->_width)
+          (delta_w > delta_h && height > width) ||
+          (delta_w < delta_h && height < width)
         ) {
-          std::swap(b->_height, b->_width);
+          std::swap(height, width);
         }
       }
       else if(_outline.first < _chip_width) {
-        if(b->_height < b->_width) {
-          std::swap(b->_height, b->_width);
+        if(height < width) {
+          std::swap(height, width);
         }
       } 
       else if(_outline.second < _chip_height) {
-        if(b->_height > b->_width) {
-          std::swap(b->_height, b->_width);
+        if(height > width) {
+          std::swap(height, width);
         }
       }
       else {
-        std::swap(b->_height, b->_width);
+        std::swap(height, width);
       }
 
       break;
@@ -775,6 +752,7 @@ void SP::_move(const std::vector<Block*>& out_bounds) {
       std::swap(_second_seq_id_loc_map[idx1], _second_seq_id_loc_map[idx2]);
 
       std::swap(_second_seq[loc1], _second_seq[loc2]);
+      _undo.push_back({false, true, static_cast<size_t>(idx1), idx2, 0, 0});
     }
     //case 5: {
       //// new move
@@ -786,184 +764,9 @@ void SP::_move(const std::vector<Block*>& out_bounds) {
       //std::swap(_second_seq[loc1], _second_seq[loc2]);
     //}
   }
-}
-
-void SP::_parse_block(
-  const std::filesystem::path& blockf
-) {
-  auto sstream = read_file_to_sstream(blockf);
-  std::string line;
-  std::string tmp;
-
-
-  // outline
-  std::getline(sstream, line);
-  if(line.find("Outline") != std::string::npos) {
-    line = line.substr(line.find(": ") + 1);
-    std::stringstream line_stream(line);
-
-    std::getline(line_stream, tmp, ' ');
-    std::getline(line_stream, tmp, ' ');
-    _outline.first = std::stoi(tmp);
-    std::getline(line_stream, tmp, ' ');
-    _outline.second = std::stoi(tmp);
-
-  }
-  else {
-    assert(false);
-  }
-
-  // numblocks
-  std::getline(sstream, line);
-  if(line.find("NumBlocks") != std::string::npos) {
-    _num_blocks = std::stoi(line.substr(line.find(": ") + 1));
-  }
-  else {
-    assert(false);
-  }
-
-  // numterminals
-  std::getline(sstream, line);
-  if(line.find("NumTerminals") != std::string::npos) {
-    _num_terminals = std::stoi(line.substr(line.find(": ") + 1));
-  }
-  else {
-    assert(false);
-  }
-
-  _blocks.reserve(_num_blocks + 2);
-  _blocks_map.reserve(_num_blocks + 2);
-  _terminals_map.reserve(_num_terminals);
-
-
-  while(std::getline(sstream, line)) {
-
-    if(!line.empty() && (line[line.length() - 1] == '\r' || line[line.length() - 1] == '\n')) {
-      line.erase(line.length() - 1);
-    }
-    if(!line.empty() && (line[line.length() - 1] == '\r' || line[line.length() - 1] == '\n')) {
-      line.erase(line.length() - 1);
-    }
-
-    if(line.size() > 1) {
-      if(line.find_first_not_of(' ') == std::string::npos) { continue; }
-      std::stringstream line_stream(line);
-      std::string token;
-      std::vector<std::string> tokens;
-
-
-      if(line.find("terminal") != std::string::npos) {
-        while(std::getline(line_stream, token, ' ')) {
-          if(token != "" && token != " " && token != "\r") {
-            tokens.push_back(token);
-          }
-        }
-
-        std::string tmp1, tmp2, tmp3;
-        std::stringstream term_stream(tokens[2]);
-        tmp1 = tokens[0];
-        std::getline(term_stream, tmp2, '\t');
-        std::getline(term_stream, tmp3, '\n');
-        _terminals_map.emplace(
-          std::piecewise_construct, 
-          std::forward_as_tuple(tmp1), 
-          std::forward_as_tuple(tmp1, _terminals_map.size(), std::stoi(tmp2), std::stoi(tmp3))
-        );
-      }
-      else {
-        while(std::getline(line_stream, token, ' ')) {
-          if(token != "" && token != " " && token != "\r") {
-            tokens.push_back(token);
-          }
-        }
-        if(tokens.size() < 3) {
-          // this is to handle 3.block...
-          tokens.clear();
-          std::stringstream line_stream(line);
-          while(std::getline(line_stream, token, '\t')) {
-            if(token != "" && token != " " && token != "\r") {
-              if(token[token.length() - 1] == '\r' || token[token.length() - 1] == '\n' || token[token.length() - 1] == ' ') {
-                token.erase(token.length() - 1);
-              }
-              tokens.push_back(token);
-            }
-          }
-        }
-
-        auto tmp = _blocks_map.emplace(
-          std::piecewise_construct, 
-          std::forward_as_tuple(tokens[0]), 
-          std::forward_as_tuple(tokens[0], _blocks_map.size(), std::stoi(tokens[1]), std::stoi(tokens[2]))
-        );
-        auto& b = (*(tmp.first)).second;
-        _blocks.push_back(&b);
-      }
-    }
-  }
-
-  assert(_blocks.size() == _num_blocks + 2);
-  assert(_blocks_map.size() == _num_blocks + 2);
-  assert(_terminals_map.size() == _num_terminals);
-}
-
-void SP::_parse_net(
-  const std::filesystem::path& netf
-) {
-  auto sstream = read_file_to_sstream(netf);
-  std::string line;
-
-
-  // numnets
-  std::getline(sstream, line);
-  if(line.find("NumNets") != std::string::npos) {
-    _num_nets = std::stoi(line.substr(line.find(": ") + 1));
-  }
-  else {
-    assert(false);
-  }
-
-  size_t degree{0};
-  std::vector<Block*> blocks;
-  std::vector<Terminal*> terminals;
-  while(std::getline(sstream, line)) {
-    if(!line.empty() && (line[line.length() - 1] == '\r' || line[line.length() - 1] == '\n')) {
-      line.erase(line.length() - 1);
-    }
-
-    if(line.find("NetDegree") != std::string::npos) {
-      if(degree != 0) {
-        _nets.emplace_back(blocks, terminals, degree);
-      }
-
-      blocks.clear();
-      terminals.clear();
-
-      degree = std::stoi(line.substr(line.find(": ") + 1));
-      blocks.reserve(degree);
-      terminals.reserve(degree / 2);
-    }
-    else {
-      auto btmp = _blocks_map.find(line);
-      if(btmp != _blocks_map.end()) {
-        blocks.push_back(&(btmp->second));
-      }
-      else { 
-        auto ttmp = _terminals_map.find(line);
-        if(ttmp != _terminals_map.end()) {
-          terminals.push_back(&(ttmp->second));
-        }
-        else {
-          assert(false);
-        }
-      }
-    }
-  }
-
-  if(degree != 0) {
-    _nets.emplace_back(blocks, terminals, degree);
-  }
 
-  assert(_nets.size() == _num_nets);
+  _touch(_undo.back().id1);
+  _touch(_undo.back().id2);
 }
 
 // unused implementation ================================================================
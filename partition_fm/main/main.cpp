@@ -1,20 +1,247 @@
-
 #include  <src/circuit.hpp>
+#include  <src/stream.hpp>
+#include  <src/sweep.hpp>
+#include  <src/spectral.hpp>
+#include  <src/compressed.hpp>
+#include  <src/process.hpp>
+#include  <src/tuner.hpp>
+#include  <src/stats.hpp>
 #include <iostream>
 
 
 int main(int argc, char** argv) {
 
-  if(argc != 4) {
-    throw std::runtime_error("Number of parameters should be exact 3!\n ./fm input_file output_file 1/0 (enable multiple passes or not)");
+  if(argc < 4) {
+    throw std::runtime_error("Number of parameters should be at least 3!\n ./fm input_file output_file 1/0 (enable multiple passes or not) [--boundary] [--heap] [--areas file] [--net-weights file] [--stream k] [--stream-init] [--spectral] [--sweep b1,b2,...] [--compressed] [--flow] [--parallel] [--processes n] [--starts s] [--tune file] [--stats] [--adaptive-stop alpha] [--fruitless-moves n]");
   }
   std::string input_file = argv[1];
-  std::ofstream output_file{argv[2]};
+  std::string output_path = argv[2];
+  std::ofstream output_file{output_path};
   int enabled = std::stoi(argv[3]);
 
-  fm::Circuit circuit(input_file, enabled);
-  circuit.fm();
-  circuit.dump(output_file);
+  bool boundary{false};
+  bool heap{false};
+  bool stream_init{false};
+  bool spectral{false};
+  bool compressed{false};
+  bool flow{false};
+  bool stats{false};
+  double adaptive_stop{0};
+  size_t fruitless_moves{0};
+  bool parallel{false};
+  long processes{-1};
+  size_t starts{2};
+  size_t stream{0};
+  std::string areas;
+  std::string net_weights;
+  std::string tune;
+  std::vector<float> sweep;
+
+  for(int i = 4; i < argc; ++i) {
+    std::string option = argv[i];
+    if(option == "--boundary") {
+      boundary = true;
+    }
+    else if(option == "--heap") {
+      heap = true;
+    }
+    else if(option == "--areas" && i + 1 < argc) {
+      areas = argv[++i];
+    }
+    else if(option == "--net-weights" && i + 1 < argc) {
+      net_weights = argv[++i];
+    }
+    else if(option == "--stream" && i + 1 < argc) {
+      stream = std::stoul(argv[++i]);
+    }
+    else if(option == "--stream-init") {
+      stream_init = true;
+    }
+    else if(option == "--spectral") {
+      spectral = true;
+    }
+    else if(option == "--processes" && i + 1 < argc) {
+      processes = std::stol(argv[++i]);
+    }
+    else if(option == "--starts" && i + 1 < argc) {
+      starts = std::stoul(argv[++i]);
+    }
+    else if(option == "--tune" && i + 1 < argc) {
+      tune = argv[++i];
+    }
+    else if(option == "--adaptive-stop" && i + 1 < argc) {
+      adaptive_stop = std::stod(argv[++i]);
+    }
+    else if(option == "--fruitless-moves" && i + 1 < argc) {
+      fruitless_moves = std::stoul(argv[++i]);
+    }
+    else if(option == "--stats") {
+      stats = true;
+    }
+    else if(option == "--parallel") {
+      parallel = true;
+    }
+    else if(option == "--flow") {
+      flow = true;
+    }
+    else if(option == "--compressed") {
+      compressed = true;
+    }
+    else if(option == "--sweep" && i + 1 < argc) {
+      std::stringstream list(argv[++i]);
+      std::string token;
+      while(std::getline(list, token, ',')) {
+        sweep.push_back(std::stof(token));
+      }
+    }
+    else {
+      throw std::runtime_error("unknown option " + option);
+    }
+  }
+
+  // input statistics only, from one streaming pass
+  if(stats) {
+    fm::Stats analyzer(input_file);
+    analyzer.analyze();
+    analyzer.summary(std::cout);
+    analyzer.summary(output_file);
+    return 0;
+  }
+
+  // streaming mode never builds the Cell/Net graph
+  if(stream != 0) {
+    fm::StreamPartitioner streamer(input_file, stream);
+    streamer.partition();
+    streamer.dump(output_file);
+    return 0;
+  }
+
+  // pin lists are kept compressed and the Cell/Net graph is never built
+  if(compressed) {
+    // it runs plain bucket F-M with the 5% stopping rule and nothing else
+    std::pair<bool, std::string> unsupported[] = {
+      {!areas.empty(), "--areas"},
+      {!net_weights.empty(), "--net-weights"},
+      {boundary, "--boundary"},
+      {heap, "--heap"},
+      {flow, "--flow"},
+      {parallel, "--parallel"},
+      {spectral, "--spectral"},
+      {stream_init, "--stream-init"},
+      {adaptive_stop != 0, "--adaptive-stop"},
+      {fruitless_moves != 0, "--fruitless-moves"},
+      {!tune.empty(), "--tune"},
+      {processes >= 0, "--processes"},
+      {!sweep.empty(), "--sweep"}
+    };
+    for(auto& [given, option]: unsupported) {
+      if(given) {
+        throw std::runtime_error(option + " cannot be combined with --compressed");
+      }
+    }
+    fm::CompressedHypergraph hypergraph(input_file);
+    fm::CompressedCircuit circuit(hypergraph, enabled);
+    circuit.fm();
+    circuit.dump(output_file);
+    return 0;
+  }
+
+  fm::Hypergraph hypergraph(input_file);
+  if(!areas.empty()) {
+    hypergraph.read_cell_areas(areas);
+  }
+  if(!net_weights.empty()) {
+    hypergraph.read_net_weights(net_weights);
+  }
+
+  // multi-start in worker processes (one per NUMA node if n is 0)
+  if(processes >= 0) {
+    fm::MultiProcess workers(hypergraph, processes, starts, enabled);
+    workers.set_configure([&](fm::Circuit& circuit) {
+      circuit.set_boundary(boundary);
+      circuit.set_heap(heap);
+      circuit.set_flow(flow);
+      circuit.set_parallel(parallel);
+      circuit.set_adaptive_stop(adaptive_stop);
+      circuit.set_max_fruitless_moves(fruitless_moves);
+    });
+    workers.apply();
+    workers.dump(output_file);
+    return 0;
+  }
+
+  // one parsed hypergraph shared by all balance factors
+  if(!sweep.empty()) {
+    fm::Sweep sweeper(hypergraph, sweep, enabled);
+    for(auto& circuit: sweeper.get_circuits()) {
+      circuit->set_boundary(boundary);
+      circuit->set_heap(heap);
+      circuit->set_flow(flow);
+      circuit->set_parallel(parallel);
+      circuit->set_adaptive_stop(adaptive_stop);
+      circuit->set_max_fruitless_moves(fruitless_moves);
+    }
+    sweeper.apply();
+    sweeper.dump(output_path);
+    sweeper.summary(std::cout);
+    sweeper.summary(output_file);
+    return 0;
+  }
+
+  // configuration stored for similar designs or tuned on a sample
+  fm::TuneConfig tuned;
+  if(!tune.empty()) {
+    fm::Tuner tuner(hypergraph, enabled);
+    tuned = tuner.tune(tune);
+    tuner.summary(std::cout);
+    std::cout << "tuned configuration: " << tuned.to_string() << "\n";
+    tuned.boundary = tuned.boundary || boundary;
+    spectral = spectral || tuned.spectral;
+  }
+
+  // one streaming pass as the initial partition of F-M
+  fm::StreamPartitioner streamer(input_file, 2);
+  if(stream_init) {
+    streamer.partition();
+  }
+
+  // Fiedler vector split as the initial partition of F-M
+  fm::Spectral spectral_init(hypergraph, tuned.max_clique_size);
+  if(spectral) {
+    spectral_init.apply();
+    std::cout << "Fiedler eigenvalue: " << spectral_init.get_eigenvalue() << "\n";
+  }
+
+  // the best of the tuned number of starts (one by default)
+  std::unique_ptr<fm::Circuit> best;
+  for(size_t s = 0; s < tuned.num_starts; ++s) {
+    auto circuit = std::make_unique<fm::Circuit>(hypergraph, enabled);
+    circuit->set_boundary(boundary);
+    circuit->set_heap(heap);
+    circuit->set_flow(flow);
+    circuit->set_parallel(parallel);
+    circuit->set_adaptive_stop(adaptive_stop);
+    circuit->set_max_fruitless_moves(fruitless_moves);
+    if(!tune.empty()) {
+      tuned.configure(*circuit);
+    }
+
+    if(stream_init) {
+      circuit->set_initial_partition([&streamer](const fm::Cell& cell) {
+        return static_cast<fm::Partition>(streamer.get_partition(cell.get_name()));
+      });
+    }
+    if(spectral) {
+      circuit->set_initial_partition([&spectral_init](const fm::Cell& cell) {
+        return static_cast<fm::Partition>(spectral_init.get_partition()[cell.get_id()]);
+      });
+    }
+
+    circuit->fm();
+    if(best == nullptr || circuit->get_cut_size() < best->get_cut_size()) {
+      best = std::move(circuit);
+    }
+  }
 
-  
+  best->dump(output_file);
 }
@@ -3,6 +3,7 @@
 #include <array>
 #include <list>
 #include <vector>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -15,230 +16,102 @@
 #include <algorithm>
 #include <random>
 #include <climits>
+#include <cmath>
+#include <functional>
 
 #include "utility.hpp"
+#include "hypergraph.hpp"
+#include "flow.hpp"
+#include "domain.hpp"
+#include "heap.hpp"
 
 namespace fm { // begin of namespace fm =======================================================================
 
-enum Partition {
-  A = 0,
-  B
-};
-
-class Cell;
-class Net;
 class Circuit;
 
 // ==============================================================================
 //
-// Declaration of class Net
-//
-// ==============================================================================
-
-class Net {
-
-  friend class Circuit;
-
-  public:
-
-    Net(const std::string& name);
-
-    const std::vector<Cell*>& get_cells();
-
-    std::string get_name();
-
-    void add_cell(Cell* cell);
-
-  private:
-
-    std::string _name;
-    std::vector<Cell*> _connected_cells;
-
-    // TODO: should we pre-find critical path?
-    //bool _is_critical{false};
-};
-
-// ==============================================================================
-//
-// Definition of class Net
-//
-// ==============================================================================
-
-Net::Net(const std::string& name): _name{name} {
-}
-
-const std::vector<Cell*>& Net::get_cells() {
-  return _connected_cells;
-}
-
-std::string Net::get_name() {
-  return _name;
-}
-
-void Net::add_cell(Cell* cell) {
-  _connected_cells.push_back(cell);
-  return;
-}
-
-// ==============================================================================
+// Declaration of class Circuit
 //
-// Declaration of class Cell
+// partitioning state of a Hypergraph. the hypergraph is only read, so several
+// circuits (e.g., one per balance factor) can share it and run concurrently.
 //
 // ==============================================================================
 
-class Cell {
 
-  friend class Circuit;
+class Circuit {
 
   public:
-  
-    Cell(const std::string& name);
-
-    const std::vector<Net*>& get_nets();
-
-    std::string get_name();
-
-    void add_net(Net*);
-
-    void set_partition(Partition par);
 
-    Partition get_partition();
-
-    void change_partition();
+    Circuit(const std::string& input_path, int enabled);
 
-    void set_fixed(bool fix);
-    bool is_fixed();
+    Circuit(const Hypergraph& hypergraph, int enabled);
 
-    void caculate_gain();
+    void fm();
 
-  private:
+    void dump(std::ostream& os);
 
-    std::string _name;
-    std::vector<Net*> _nets;
+    void set_boundary(bool boundary);
 
-    bool _is_fixed{false};
-    Partition _par;
-    int _gain{0};
-    int _prev_gain{0};
-    std::list<Cell*>::iterator _loc;
-};
+    void set_heap(bool heap);
 
+    void set_flow(bool flow);
 
+    void set_parallel(bool parallel);
 
+    void set_balance_factor(float balance_factor);
 
-// ==============================================================================
-//
-// Definition of class Cell
-//
-// ==============================================================================
+    // passes stop at max_num_passes or once a pass improves the cut by less
+    // than min_improvement (ratio), 10 and 0.05 by default
+    void set_max_num_passes(int max_num_passes);
 
+    void set_min_improvement(float min_improvement);
 
-Cell::Cell(const std::string& name): _name{name} {
-}
-
-const std::vector<Net*>& Cell::get_nets() {
-  return _nets;
-}
-
-std::string Cell::get_name() {
-  return _name;
-}
-
-void Cell::add_net(Net* net) {
-  _nets.push_back(net);
-  return;
-}
-
-Partition Cell::get_partition() {
-  return _par;
-}
+    // a pass stops early once the moves since its best prefix look like a
+    // random walk that will not climb back (alpha > 0, KaHyPar's adaptive
+    // rule), or after max_fruitless_moves moves without a new best (> 0)
+    void set_adaptive_stop(double alpha);
 
-void Cell::set_partition(Partition par) {
-  _par = par;
-}
+    void set_max_fruitless_moves(size_t max_fruitless_moves);
 
-void Cell::change_partition() {
-  switch(_par) {
-    case Partition::A:
-      _par = Partition::B;
-      break;
-    case Partition::B:
-      _par = Partition::A;
-      break;
-  }
-}
+    void set_verbose(bool verbose);
 
-bool Cell::is_fixed() {
-  return _is_fixed;
-}
+    void set_initial_partition(const std::function<Partition(const Cell&)>& init);
 
-void Cell::set_fixed(bool fix) {
-  _is_fixed = fix;
-}
+    size_t get_cut_size() const;
 
-void Cell::caculate_gain() {
-  _gain = 0;
+    size_t get_num_cells(Partition par) const;
 
-  for(auto* n: _nets) {
-    int from{0};
-    int to{0};
+    double get_area(Partition par) const;
 
-    for(auto* c: n->get_cells()) {
-      if(_par != c->get_partition()) {
-        ++to;
-      }
-      else {
-        ++from;
-      }
+    // partition of every cell, indexed by cell id
+    const std::vector<Partition>& get_partition() const;
 
-      if(to > 1 && from > 1) {
-        break;
-      }
-    } 
+    size_t get_initial_cut_size() const;
 
-    if(from == 1) {
-      ++_gain;
-    }
-    if(to == 0) {
-      --_gain;
-    }
-  }
+    size_t get_num_passes() const;
 
-  return;
-}
-
-
-// ==============================================================================
-//
-// Declaration of class Circuit
-//
-// ==============================================================================
-
-
-class Circuit {
-
-  public:
-
-    Circuit(const std::string& input_path, int enabled);
+  private:
 
-    ~Circuit();
+    void _initialize_cells();
 
-    void fm();
+    void _initialize_partition();
 
-    void dump(std::ostream& os);
+    void _initialize_buckets();
 
+    void _initialize_nets();
 
-  private:
+    void _initialize_boundary();
 
-    void _parse();
+    void _activate(Cell* cell);
 
-    void _initialize_cells();
+    void _caculate_gain(Cell* cell);
 
-    void _initialize_partition();
+    void _insert_cell(Cell* cell);
 
-    void _initialize_max_gain();
+    void _update_cell(Cell* cell);
 
-    void _initialize_buckets();
+    Cell* _choose_candidate_heap();
 
     void _reset_pass();
 
@@ -250,27 +123,84 @@ class Circuit {
 
     void _reverse();
 
+    bool _stop(int move_gain, int gain);
+
+    void _drain();
+
     void _undo(Cell* cand);
 
+    void _move(Cell* cell);
+
     void _caculate_cut_size();
 
-    void _set_max_gain();
+    bool _refine_flow();
+
+    void _refine_domains();
+
+    std::unique_ptr<Hypergraph> _owned_hypergraph;
+    const Hypergraph& _hg;
 
-    std::unordered_map<std::string, Net*> _nets;
-    std::unordered_map<std::string, Cell*> _cells;
     float _balance_factor;
-    std::filesystem::path _input_path;
     int _max_gain{0};
     size_t _cut_size{0};
+    size_t _initial_cut_size{0};
+    size_t _num_passes{0};
     int _enabled;
+    int _max_num_passes{10};
+    float _min_improvement{0.05f};
+
+    // early stop of a pass: moves since the best prefix and the running mean
+    // and squared deviation of their gains
+    double _stop_alpha{0};
+    size_t _max_fruitless_moves{0};
+    size_t _num_fruitless{0};
+    int _best_gain{0};
+    double _stop_mean{0};
+    double _stop_m2{0};
+    bool _boundary{false};
+    bool _use_heap{false};
+    bool _flow{false};
+    double _flow_alpha{8};
+    std::unique_ptr<FlowRefiner> _flow_refiner;
+    bool _parallel{false};
+    std::unique_ptr<DomainRefiner> _domain_refiner;
     std::vector<std::list<Cell*>> _bucket_a;
     std::vector<std::list<Cell*>> _bucket_b;
+    std::array<GainHeap, 2> _heaps;
+
+    // per-cell state, indexed by cell id
+    std::vector<Partition> _pars;
+    std::vector<int> _gains;
+    std::vector<int> _prev_gains;
+    std::vector<char> _is_fixed;
+    std::vector<char> _is_active;
+    std::vector<std::list<Cell*>::iterator> _locs;
+
+    // per-net state, indexed by net id
+    // number of connected cells in partition a and b
+    std::vector<std::array<size_t, 2>> _net_counts;
+    // location in _cut_nets (-1 if the net is not cut)
+    std::vector<int> _cut_idx;
 
     // 0 -> partition a
     // 1 -> partition b
     std::array<size_t, 2> _num_cells_in_partition{0, 0};
+    std::array<double, 2> _area_in_partition{0, 0};
+    double _total_area{0};
+
+    // random initial partition if empty
+    std::function<Partition(const Cell&)> _initial_partition;
 
     std::vector<std::pair<Cell*, int>> _cand_gains;
+
+    // nets whose cells span both partitions and their total weight
+    std::vector<Net*> _cut_nets;
+    int64_t _cut_weight{0};
+
+    // cells inserted into buckets in current pass (boundary mode)
+    std::vector<Cell*> _active_cells;
+
+    std::ostream _log{std::cout.rdbuf()};
 };
 
 // ==============================================================================
@@ -279,249 +209,455 @@ class Circuit {
 //
 // ==============================================================================
 
-Circuit::Circuit(const std::string& input_path, int enabled): _input_path{input_path}, _enabled{enabled} {
-  _parse();
+inline
+Circuit::Circuit(const std::string& input_path, int enabled):
+  _owned_hypergraph{std::make_unique<Hypergraph>(input_path)},
+  _hg{*_owned_hypergraph},
+  _balance_factor{_hg.get_balance_factor()},
+  _enabled{enabled} {
 }
 
-Circuit::~Circuit() {
-
-  for(auto&& n: _nets) {
-    delete n.second;
-  }
-
-  for(auto&& c: _cells) {
-    delete c.second;
-  }
+inline
+Circuit::Circuit(const Hypergraph& hypergraph, int enabled):
+  _hg{hypergraph},
+  _balance_factor{_hg.get_balance_factor()},
+  _enabled{enabled} {
 }
 
+inline
 void Circuit::fm() {
 
-  std::cout << "=================================================================================\n\n"
-            << "                    F-M Circuit Partitioning           \n\n"
-            << "./fm input_file output_file 1/0 (enable multiple passes or not) \n\n"
-            << "#1. I randomly partition a given circuit and apply F-M to improve cut size.\n"
-            << "#2. If the third parameter is 1 (i.e., enable), my algorihm will keep running\n"
-            << "until improvement ratio is less than 5\% or the number of passes is 10. \n"
-            << "#3. If the third parameter is 0 (i.e., disable), I will run F-M for one pass\n\n."
-            << "==================================================================================\n\n";
+  _log << "=================================================================================\n\n"
+       << "                    F-M Circuit Partitioning           \n\n"
+       << "./fm input_file output_file 1/0 (enable multiple passes or not) \n\n"
+       << "#1. I randomly partition a given circuit and apply F-M to improve cut size.\n"
+       << "#2. If the third parameter is 1 (i.e., enable), my algorihm will keep running\n"
+       << "until improvement ratio is less than 5\% or the number of passes is 10. \n"
+       << "#3. If the third parameter is 0 (i.e., disable), I will run F-M for one pass\n"
+       << "#4. With --boundary, only cells on cut nets (and cells exposed by moves) enter buckets.\n"
+       << "#5. With --areas/--net-weights, balance uses cell areas and gains are kept in heaps.\n\n."
+       << "==================================================================================\n\n";
+
+  size_t num_cells = _hg.get_cells().size();
+  _pars.assign(num_cells, Partition::A);
+  _gains.assign(num_cells, 0);
+  _prev_gains.assign(num_cells, 0);
+  _is_fixed.assign(num_cells, false);
+  _is_active.assign(num_cells, false);
+  _locs.resize(num_cells);
+
+  _max_gain = _hg.get_max_gain();
+  _use_heap = _use_heap || _hg.is_weighted();
+  _heaps[0].initialize(_gains);
+  _heaps[1].initialize(_gains);
 
   _initialize_partition();
-  _set_max_gain();
+  _initialize_nets();
   _caculate_cut_size();
+  _flow_alpha = 8;
+  _initial_cut_size = _cut_size;
 
-  std::cout << "finish parsing and initializing...\n\n"
-            << "////////////////////////\n"
-            << "Maximum available gain: " << _max_gain << "\n"
-            << "Initial cut size: " << _cut_size << "\n"
-            << "////////////////////////\n";
+  _log << "finish parsing and initializing...\n\n"
+       << "////////////////////////\n"
+       << "Balance factor: " << _balance_factor << "\n"
+       << "Maximum available gain: " << _max_gain << "\n"
+       << "Gain container: " << (_use_heap ? "heap" : "bucket") << "\n"
+       << "Initial cut size: " << _cut_size << "\n"
+       << "////////////////////////\n";
 
   size_t prev_cut_size{_cut_size};
-  int MAX_NUM_PASSES{10};
+  int MAX_NUM_PASSES{_max_num_passes};
   if(_enabled == 0) {
     MAX_NUM_PASSES = 1;
   }
   int p{0};
+  bool parallel{_parallel};
 
   while(true) {
 
-    std::cout << "\nPass: " << p++ << "\n";
-
-    int gain{0};
-    _reset_pass();
-
-    std::cout << "finish resetting...\n"
-              << "start fm...\n";
+    _log << "\nPass: " << p++ << "\n";
 
-    Cell* cand = _choose_candidate();
+    if(parallel) {
+      _refine_domains();
+    }
+    else {
+      int gain{0};
+      _reset_pass();
+
+      _log << "finish resetting...\n"
+           << "start fm...\n";
+
+      _best_gain = 0;
+      _num_fruitless = 0;
+      _stop_mean = 0;
+      _stop_m2 = 0;
+
+      Cell* cand = _choose_candidate();
+
+      while(cand != nullptr) {
+        int move_gain = _gains[cand->get_id()];
+        gain += move_gain;
+        _update(cand);
+        _cand_gains.push_back({cand, gain});
+        if(_stop(move_gain, gain)) {
+          _log << "stopped after " << _cand_gains.size() << " moves\n";
+          _drain();
+          break;
+        }
+        cand = _choose_candidate();
+      }
 
-    while(cand != nullptr) {
-      gain += cand->_gain;
-      _update(cand);
-      _cand_gains.push_back({cand, gain});
-      cand = _choose_candidate();
+      _reverse();
     }
 
-    _reverse();
     _caculate_cut_size();
     float delta = prev_cut_size - _cut_size;
     float improve = delta / prev_cut_size;
-    std::cout << "###### current cut size: " << _cut_size << "\n"
-              << "###### improvement compared to previous pass: " << improve << "\n";
+    _log << "###### current cut size: " << _cut_size << "\n"
+         << "###### improvement compared to previous pass: " << improve << "\n";
 
-    // if improvment less than 5%, terminate the loop
-    if(improve < 0.05f || p == MAX_NUM_PASSES) {
-      break;
+    _num_passes = p;
+
+    // once region passes stall, sequential passes take over to fix the nets
+    // that cross regions
+    if(parallel && improve < _min_improvement && p < MAX_NUM_PASSES) {
+      parallel = false;
+      prev_cut_size = _cut_size;
+      continue;
+    }
+
+    // if improvment less than the threshold (5% by default), try flow
+    // refinement on the cut region and only keep running F-M if it helped
+    if(improve < _min_improvement || p == MAX_NUM_PASSES) {
+      if(!_flow || !_refine_flow() || p == MAX_NUM_PASSES) {
+        break;
+      }
     }
 
     prev_cut_size = _cut_size;
   }
 
-  std::cout << "done.\n\n";
+  _log << "done.\n\n";
 }
 
+inline
 void Circuit::dump(std::ostream& os) {
 
-  std::vector<std::string> _cells_par_a;
-  std::vector<std::string> _cells_par_b;
+  std::vector<const std::string*> _cells_par_a;
+  std::vector<const std::string*> _cells_par_b;
   _cells_par_a.reserve(_num_cells_in_partition[0]);
   _cells_par_b.reserve(_num_cells_in_partition[1]);
 
-  for(auto&& s_c: _cells) {
-    if(s_c.second->get_partition() == Partition::A) {
-      _cells_par_a.push_back(s_c.first);
+  for(auto* c: _hg.get_cells()) {
+    if(_pars[c->get_id()] == Partition::A) {
+      _cells_par_a.push_back(&c->get_name());
     }
     else {
-      _cells_par_b.push_back(s_c.first);
+      _cells_par_b.push_back(&c->get_name());
     }
   }
 
   os << "Cutsize = " << _cut_size << "\n";
-  os << "G1 " << _num_cells_in_partition[0] << "\n"; 
+  os << "G1 " << _num_cells_in_partition[0] << "\n";
 
-  for(auto&& str: _cells_par_a) {
-    os << str << " ";
+  for(auto* str: _cells_par_a) {
+    os << *str << " ";
   }
   os << ";\n";
 
-  os << "G2 " << _num_cells_in_partition[1] << "\n"; 
+  os << "G2 " << _num_cells_in_partition[1] << "\n";
 
-  for(auto&& str: _cells_par_b) {
-    os << str << " ";
+  for(auto* str: _cells_par_b) {
+    os << *str << " ";
   }
   os << ";\n";
-  
-  
+
+
+}
+
+
+inline
+void Circuit::set_boundary(bool boundary) {
+  _boundary = boundary;
 }
 
+inline
+void Circuit::set_heap(bool heap) {
+  _use_heap = heap;
+}
 
-void Circuit::_parse() {
-  auto sstream = read_file_to_sstream(_input_path);
-  std::string line;
+inline
+void Circuit::set_flow(bool flow) {
+  _flow = flow;
+}
 
-  // first line is balance factor
-  std::getline(sstream, line);
-  _balance_factor = std::stof(line);
+inline
+void Circuit::set_parallel(bool parallel) {
+  _parallel = parallel;
+}
 
-  std::vector<std::string> tokens;
-  while(std::getline(sstream, line, ';')) {
-    line.erase(std::remove(line.begin(), line.end(), '\n'), line.cend());
-    std::stringstream line_stream(line);
-    std::string token;
-    tokens.clear();
+inline
+void Circuit::set_balance_factor(float balance_factor) {
+  _balance_factor = balance_factor;
+}
 
-    line_stream >> std::ws;
-    while(std::getline(line_stream, token, ' ')) {
-      tokens.push_back(token);
-    }
+inline
+void Circuit::set_max_num_passes(int max_num_passes) {
+  _max_num_passes = std::max(max_num_passes, 1);
+}
 
-    // net
-    Net* net = new Net(tokens[1]);
-    _nets.insert({net->get_name(), net});
+inline
+void Circuit::set_min_improvement(float min_improvement) {
+  _min_improvement = min_improvement;
+}
 
-    // cells
-    for(size_t i = 2; i < tokens.size(); ++i) {
-      if(tokens[i] != "") {
-        auto iter = _cells.find(tokens[i]);
-        Cell* cell{nullptr};
+inline
+void Circuit::set_adaptive_stop(double alpha) {
+  _stop_alpha = alpha;
+}
 
-        if(iter == _cells.end()) {
-          cell = new Cell(tokens[i]);
-        }
-        else {
-          cell = (*iter).second;
-        }
+inline
+void Circuit::set_max_fruitless_moves(size_t max_fruitless_moves) {
+  _max_fruitless_moves = max_fruitless_moves;
+}
 
-        _cells.insert({cell->get_name(), cell});
-        net->add_cell(cell);
-        cell->add_net(net);
-      }
-    }
-  }
+inline
+void Circuit::set_verbose(bool verbose) {
+  _log.rdbuf(verbose ? std::cout.rdbuf() : nullptr);
 }
 
-void Circuit::_set_max_gain() {
-  _max_gain = 0;
-  for(auto&& s_c: _cells) {
-    Cell* c = s_c.second;
-    if(c->get_nets().size() > _max_gain) {
-      _max_gain = c->get_nets().size();
-    }
-  }
-  return;
+inline
+void Circuit::set_initial_partition(const std::function<Partition(const Cell&)>& init) {
+  _initial_partition = init;
+}
+
+inline
+size_t Circuit::get_cut_size() const {
+  return _cut_size;
 }
 
+inline
+size_t Circuit::get_num_cells(Partition par) const {
+  return _num_cells_in_partition[par];
+}
+
+inline
+double Circuit::get_area(Partition par) const {
+  return _area_in_partition[par];
+}
+
+inline
+const std::vector<Partition>& Circuit::get_partition() const {
+  return _pars;
+}
+
+inline
+size_t Circuit::get_initial_cut_size() const {
+  return _initial_cut_size;
+}
+
+inline
+size_t Circuit::get_num_passes() const {
+  return _num_passes;
+}
+
+inline
 void Circuit::_initialize_cells() {
   _cand_gains.clear();
-  _cand_gains.reserve(_cells.size());
+  _cand_gains.reserve(_hg.get_cells().size());
 
-  for(auto&& s_c: _cells) {
-    Cell* c = s_c.second;
-    c->caculate_gain();
-    c->_prev_gain = c->_gain;
-    c->set_fixed(false);
+  for(auto* c: _hg.get_cells()) {
+    _caculate_gain(c);
+    _is_fixed[c->get_id()] = false;
   }
   return;
 }
 
+// gain from per-net partition counts, O(degree) instead of O(pins)
+inline
+void Circuit::_caculate_gain(Cell* c) {
+  size_t id = c->get_id();
+  int from = _pars[id];
+  int to = (from + 1) % 2;
+
+  _gains[id] = 0;
+  for(auto* n: c->get_nets()) {
+    if(_net_counts[n->get_id()][from] == 1) {
+      _gains[id] += n->get_weight();
+    }
+    if(_net_counts[n->get_id()][to] == 0) {
+      _gains[id] -= n->get_weight();
+    }
+  }
+  _prev_gains[id] = _gains[id];
+}
+
 // random
+inline
 void Circuit::_initialize_partition() {
   std::random_device rd{};
   std::mt19937 eng(rd());
   std::uniform_int_distribution<> distr(0, 1);
-  std::array<Partition, 2> choose{Partition::A, Partition::B}; 
+  std::array<Partition, 2> choose{Partition::A, Partition::B};
 
-  for(auto&& s_c: _cells) {
-    auto random = distr(eng);
+  _num_cells_in_partition = {0, 0};
+  _area_in_partition = {0, 0};
+  _total_area = 0;
+
+  for(auto* c: _hg.get_cells()) {
+    auto random = _initial_partition ? _initial_partition(*c) : distr(eng);
     //int random = rand() % 2;
 
-    Cell* c = s_c.second;
-    c->_gain = 0;
-    c->set_partition(choose[random]);
+    _pars[c->get_id()] = choose[random];
 
     ++_num_cells_in_partition[random];
+    _area_in_partition[random] += c->get_area();
+    _total_area += c->get_area();
   }
 
   assert(
-    (_num_cells_in_partition[0] + _num_cells_in_partition[1]) == _cells.size()
+    (_num_cells_in_partition[0] + _num_cells_in_partition[1]) == _hg.get_cells().size()
   );
 
   return;
 }
 
+inline
 void Circuit::_initialize_buckets() {
-  _bucket_a.clear();
-  _bucket_b.clear();
-  _bucket_a.resize(_max_gain * 2 + 1);
-  _bucket_b.resize(_max_gain * 2 + 1);
-  
-  for(auto&& s_c: _cells) {
-    Cell* c = s_c.second;
-    switch(c->get_partition()) {
-      case Partition::A:
-        _bucket_a[c->_gain + _max_gain].push_back(c);
-        c->_loc = _bucket_a[c->_gain + _max_gain].end();
-        --c->_loc;
-        break;
-      case Partition::B:
-        _bucket_b[c->_gain + _max_gain].push_back(c);
-        c->_loc = _bucket_b[c->_gain + _max_gain].end();
-        --c->_loc;
-        break;
+  if(_use_heap) {
+    _heaps[0].clear();
+    _heaps[1].clear();
+  }
+  else {
+    _bucket_a.clear();
+    _bucket_b.clear();
+    _bucket_a.resize(_max_gain * 2 + 1);
+    _bucket_b.resize(_max_gain * 2 + 1);
+  }
+
+  for(auto* c: _hg.get_cells()) {
+    _insert_cell(c);
+  }
+}
+
+inline
+void Circuit::_insert_cell(Cell* c) {
+  size_t id = c->get_id();
+
+  if(_use_heap) {
+    _heaps[_pars[id]].push(id);
+    return;
+  }
+
+  switch(_pars[id]) {
+    case Partition::A:
+      _bucket_a[_gains[id] + _max_gain].push_back(c);
+      _locs[id] = _bucket_a[_gains[id] + _max_gain].end();
+      --_locs[id];
+      break;
+    case Partition::B:
+      _bucket_b[_gains[id] + _max_gain].push_back(c);
+      _locs[id] = _bucket_b[_gains[id] + _max_gain].end();
+      --_locs[id];
+      break;
+  }
+}
+
+inline
+void Circuit::_initialize_nets() {
+  _net_counts.assign(_hg.get_nets().size(), {0, 0});
+  _cut_idx.assign(_hg.get_nets().size(), -1);
+  _cut_nets.clear();
+  _cut_weight = 0;
+
+  for(auto* n: _hg.get_nets()) {
+    auto& counts = _net_counts[n->get_id()];
+
+    for(auto* c: n->get_cells()) {
+      ++counts[_pars[c->get_id()]];
+    }
+
+    if(counts[0] != 0 && counts[1] != 0) {
+      _cut_idx[n->get_id()] = _cut_nets.size();
+      _cut_nets.push_back(n);
+      _cut_weight += n->get_weight();
     }
   }
 }
 
+// boundary mode
+// only cells on cut nets are inserted into buckets at the beginning of a pass.
+// other cells are activated in _update once a move makes their net cut.
+inline
+void Circuit::_initialize_boundary() {
+  for(auto* c: _active_cells) {
+    _is_active[c->get_id()] = false;
+    _is_fixed[c->get_id()] = false;
+  }
+  _active_cells.clear();
+
+  _cand_gains.clear();
+
+  // buckets are drained by _choose_candidate at the end of each pass
+  if(_use_heap) {
+    _heaps[0].clear();
+    _heaps[1].clear();
+  }
+  else if(_bucket_a.size() != static_cast<size_t>(_max_gain * 2 + 1)) {
+    _bucket_a.clear();
+    _bucket_b.clear();
+    _bucket_a.resize(_max_gain * 2 + 1);
+    _bucket_b.resize(_max_gain * 2 + 1);
+  }
+
+  for(auto* n: _cut_nets) {
+    for(auto* c: n->get_cells()) {
+      _activate(c);
+    }
+  }
+}
+
+inline
+void Circuit::_activate(Cell* c) {
+  if(_is_active[c->get_id()]) {
+    return;
+  }
+
+  _is_active[c->get_id()] = true;
+  _active_cells.push_back(c);
+
+  _caculate_gain(c);
+  _insert_cell(c);
+}
+
+inline
 void Circuit::_reset_pass() {
+  if(_boundary) {
+    _initialize_boundary();
+    return;
+  }
+
   _initialize_cells();
   _initialize_buckets();
 }
 
+inline
 void Circuit::_update(Cell* cand) {
-  
-  Partition prev_par = cand->get_partition();
-  cand->change_partition();
-  --_num_cells_in_partition[prev_par];
-  ++_num_cells_in_partition[(prev_par + 1) % 2];
+
+  Partition prev_par = _pars[cand->get_id()];
+  int prev_to_par = (prev_par + 1) % 2;
+
+  // boundary mode: a net that is not cut before the move becomes cut,
+  // so its cells may now have non-trivial gains
+  if(_boundary) {
+    for(auto* n: cand->get_nets()) {
+      if(_net_counts[n->get_id()][prev_to_par] == 0) {
+        for(auto* c: n->get_cells()) {
+          _activate(c);
+        }
+      }
+    }
+  }
 
   //std::cerr << "1111111\n";
   //std::chrono::time_point<std::chrono::steady_clock> tic;
@@ -529,41 +665,27 @@ void Circuit::_update(Cell* cand) {
 
 
   //tic = std::chrono::steady_clock::now();
-  // =======================================================  
+  // =======================================================
   //  find critical nets and update corresponding cells
-  // =======================================================  
+  // =======================================================
   for(auto* n: cand->get_nets()) {
-    int prev_from{1};
-    int prev_to{0};
-    for(auto* c: n->get_cells()) {
-      if(c != cand) {
-        if(prev_par != c->get_partition()) {
-          ++prev_to;
-        }
-        else {
-          ++prev_from;
-        }
-
-        if(prev_to > 2 && prev_from > 2) {
-          break;
-        }
-      }
-    }
-
+    int prev_from = _net_counts[n->get_id()][prev_par];
+    int prev_to = _net_counts[n->get_id()][prev_to_par];
+    int w = n->get_weight();
 
     // case 1 before move
     if(prev_to == 0) {
       for(auto* c: n->get_cells()) {
-        if(!c->is_fixed()) {
-          ++c->_gain;
+        if(!_is_fixed[c->get_id()]) {
+          _gains[c->get_id()] += w;
         }
       }
     }
     // case 2 before move
     else if(prev_to == 1) {
       for(auto* c: n->get_cells()) {
-        if(!c->is_fixed() && c->get_partition() != prev_par) {
-          --c->_gain;
+        if(!_is_fixed[c->get_id()] && _pars[c->get_id()] != prev_par) {
+          _gains[c->get_id()] -= w;
         }
       }
     }
@@ -574,44 +696,32 @@ void Circuit::_update(Cell* cand) {
     // case 1 after move
     if(from == 0) {
       for(auto* c: n->get_cells()) {
-        if(!c->is_fixed()) {
-          --c->_gain;
+        if(!_is_fixed[c->get_id()]) {
+          _gains[c->get_id()] -= w;
         }
       }
     }
     // case 2 after move
     else if (from == 1) {
       for(auto* c: n->get_cells()) {
-        if(!c->is_fixed() && c->get_partition() == prev_par) {
-          ++c->_gain;
+        if(!_is_fixed[c->get_id()] && _pars[c->get_id()] == prev_par) {
+          _gains[c->get_id()] += w;
         }
       }
     }
   }
+
+  _move(cand);
   //toc = std::chrono::steady_clock::now();
   //std::cerr << "update gain time: " << std::chrono::duration_cast<std::chrono::microseconds>(toc - tic).count() << "\n";
 
   //tic = std::chrono::steady_clock::now();
   for(auto* n: cand->get_nets()) {
     for(auto* c: n->get_cells()) {
-      if((!c->is_fixed()) && (c->_prev_gain != c->_gain)) {
-
-        switch(c->get_partition()) {
-          case Partition::A:
-            _bucket_a[c->_gain + _max_gain].push_back(c);
-            _bucket_a[c->_prev_gain + _max_gain].erase(c->_loc);
-            c->_loc = _bucket_a[c->_gain + _max_gain].end();
-            --c->_loc;
-            break;
-          case Partition::B:
-            _bucket_b[c->_gain + _max_gain].push_back(c);
-            _bucket_b[c->_prev_gain + _max_gain].erase(c->_loc);
-            c->_loc = _bucket_b[c->_gain + _max_gain].end();
-            --c->_loc;
-            break;
-        }
-
-        c->_prev_gain = c->_gain;
+      size_t id = c->get_id();
+      if((!_is_fixed[id]) && (_prev_gains[id] != _gains[id])) {
+        _update_cell(c);
+        _prev_gains[id] = _gains[id];
       }
     }
   }
@@ -622,22 +732,53 @@ void Circuit::_update(Cell* cand) {
   return;
 }
 
+// move cell from the bucket of its previous gain to the bucket of its gain
+inline
+void Circuit::_update_cell(Cell* c) {
+  size_t id = c->get_id();
+
+  if(_use_heap) {
+    _heaps[_pars[id]].update(id);
+    return;
+  }
+
+  switch(_pars[id]) {
+    case Partition::A:
+      _bucket_a[_gains[id] + _max_gain].push_back(c);
+      _bucket_a[_prev_gains[id] + _max_gain].erase(_locs[id]);
+      _locs[id] = _bucket_a[_gains[id] + _max_gain].end();
+      --_locs[id];
+      break;
+    case Partition::B:
+      _bucket_b[_gains[id] + _max_gain].push_back(c);
+      _bucket_b[_prev_gains[id] + _max_gain].erase(_locs[id]);
+      _locs[id] = _bucket_b[_gains[id] + _max_gain].end();
+      --_locs[id];
+      break;
+  }
+}
+
+inline
 Cell* Circuit::_choose_candidate() {
 
+  if(_use_heap) {
+    return _choose_candidate_heap();
+  }
+
   Cell* cand = nullptr;
   for(int i = _max_gain * 2; i >= 0; --i) {
 
     while(!_bucket_a[i].empty() || !_bucket_b[i].empty()) {
       if(!_bucket_a[i].empty()) {
         cand = _bucket_a[i].front();
-        _bucket_a[cand->_gain + _max_gain].erase(_bucket_a[cand->_gain + _max_gain].begin());
+        _bucket_a[i].pop_front();
       }
       else {
         cand = _bucket_b[i].front();
-        _bucket_b[cand->_gain + _max_gain].erase(_bucket_b[cand->_gain + _max_gain].begin());
+        _bucket_b[i].pop_front();
       }
 
-      cand->set_fixed(true);
+      _is_fixed[cand->get_id()] = true;
 
       if(_check(cand)) {
         return cand;
@@ -648,23 +789,46 @@ Cell* Circuit::_choose_candidate() {
   return nullptr;
 }
 
+// same tie-breaking as buckets: partition a first when gains are equal
+inline
+Cell* Circuit::_choose_candidate_heap() {
+
+  while(!_heaps[0].empty() || !_heaps[1].empty()) {
+    int par = 0;
+    if(_heaps[0].empty() || (!_heaps[1].empty() && _gains[_heaps[1].top()] > _gains[_heaps[0].top()])) {
+      par = 1;
+    }
+
+    Cell* cand = _hg.get_cells()[_heaps[par].pop()];
+    _is_fixed[cand->get_id()] = true;
+
+    if(_check(cand)) {
+      return cand;
+    }
+  }
+
+  return nullptr;
+}
+
+// balance is measured by cell area (one per cell if no area is given)
+inline
 bool Circuit::_check(Cell* cell) {
 
 
   bool valid{false};
 
-  switch(cell->_par) {
+  switch(_pars[cell->get_id()]) {
 
     case Partition::A:
       valid =
-      ((_cells.size() * (1 - _balance_factor) / 2) < (_num_cells_in_partition[0] - 1)) &&
-      ((_num_cells_in_partition[1] + 1) < (_cells.size() * (1 + _balance_factor) / 2));
+      ((_total_area * (1 - _balance_factor) / 2) < (_area_in_partition[0] - cell->get_area())) &&
+      ((_area_in_partition[1] + cell->get_area()) < (_total_area * (1 + _balance_factor) / 2));
       break;
 
     case Partition::B:
-      valid = 
-      ((_cells.size() * (1 - _balance_factor) / 2) < (_num_cells_in_partition[1] - 1)) &&
-      ((_num_cells_in_partition[0] + 1) < (_cells.size() * (1 + _balance_factor) / 2));
+      valid =
+      ((_total_area * (1 - _balance_factor) / 2) < (_area_in_partition[1] - cell->get_area())) &&
+      ((_area_in_partition[0] + cell->get_area()) < (_total_area * (1 + _balance_factor) / 2));
       break;
   }
 
@@ -673,6 +837,7 @@ bool Circuit::_check(Cell* cell) {
 }
 
 // find maximum total gain and reverse
+inline
 void Circuit::_reverse() {
   int max{INT_MIN};
   int max_id{0};
@@ -688,40 +853,205 @@ void Circuit::_reverse() {
   }
 }
 
+// the gains after the best prefix are treated as a random walk with mean mu
+// and variance sigma^2. it needs about sigma^2 / mu^2 steps to climb back, so
+// the pass stops once it has walked alpha times that long (and more than
+// ln(#cells) steps). plateaus of zero-gain moves (mean 0) never stop the
+// pass, F-M often climbs out of them. statistics restart at every new best.
+inline
+bool Circuit::_stop(int move_gain, int gain) {
+
+  if(gain > _best_gain) {
+    _best_gain = gain;
+    _num_fruitless = 0;
+    _stop_mean = 0;
+    _stop_m2 = 0;
+    return false;
+  }
+
+  ++_num_fruitless;
+  if(_max_fruitless_moves != 0 && _num_fruitless >= _max_fruitless_moves) {
+    return true;
+  }
+  if(_stop_alpha <= 0) {
+    return false;
+  }
+
+  double delta = move_gain - _stop_mean;
+  _stop_mean += delta / _num_fruitless;
+  _stop_m2 += delta * (move_gain - _stop_mean);
+
+  double beta = std::log(static_cast<double>(_hg.get_cells().size()));
+  if(_num_fruitless <= beta) {
+    return false;
+  }
+
+  double variance = _stop_m2 / (_num_fruitless - 1);
+  return _stop_mean < 0 && _num_fruitless >= _stop_alpha * variance / (_stop_mean * _stop_mean);
+}
+
+// boundary mode reuses the buckets across passes and expects them to be
+// drained, so the cells left after an early stop are taken out here. the
+// other modes rebuild the containers in _reset_pass.
+inline
+void Circuit::_drain() {
+  if(!_boundary || _use_heap) {
+    return;
+  }
+
+  for(auto* c: _active_cells) {
+    size_t id = c->get_id();
+    if(_is_fixed[id]) {
+      continue;
+    }
+    _is_fixed[id] = true;
+    if(_pars[id] == Partition::A) {
+      _bucket_a[_prev_gains[id] + _max_gain].erase(_locs[id]);
+    }
+    else {
+      _bucket_b[_prev_gains[id] + _max_gain].erase(_locs[id]);
+    }
+  }
+}
+
+inline
 void Circuit::_undo(Cell* cand) {
-  Partition prev_par = cand->get_partition();
-  cand->change_partition();
+  _move(cand);
+}
+
+// move a cell to the other partition and maintain per-net counts and cut nets
+inline
+void Circuit::_move(Cell* cell) {
+  Partition prev_par = _pars[cell->get_id()];
+  Partition to_par = static_cast<Partition>((prev_par + 1) % 2);
+  _pars[cell->get_id()] = to_par;
   --_num_cells_in_partition[prev_par];
-  ++_num_cells_in_partition[(prev_par + 1) % 2];
+  ++_num_cells_in_partition[to_par];
+  _area_in_partition[prev_par] -= cell->get_area();
+  _area_in_partition[to_par] += cell->get_area();
+
+  for(auto* n: cell->get_nets()) {
+    auto& counts = _net_counts[n->get_id()];
+    int& cut_idx = _cut_idx[n->get_id()];
+    bool was_cut = (cut_idx != -1);
+    --counts[prev_par];
+    ++counts[to_par];
+    bool is_cut = counts[0] != 0 && counts[1] != 0;
+
+    if(!was_cut && is_cut) {
+      cut_idx = _cut_nets.size();
+      _cut_nets.push_back(n);
+      _cut_weight += n->get_weight();
+    }
+    else if(was_cut && !is_cut) {
+      _cut_weight -= n->get_weight();
+      _cut_idx[_cut_nets.back()->get_id()] = cut_idx;
+      _cut_nets[cut_idx] = _cut_nets.back();
+      _cut_nets.pop_back();
+      cut_idx = -1;
+    }
+  }
 }
 
 
-void Circuit::_caculate_cut_size() {
+// corridors are refined concurrently, then applied one at a time and kept only
+// if the cut really drops and the balance holds. corridors share nets, so a
+// move set can be worse than its flow predicted once another one is applied.
+// alpha (corridor size over its slack share) is halved until a round helps
+// and then kept for the next round.
+inline
+bool Circuit::_refine_flow() {
 
-  _cut_size = 0;
+  if(!_flow_refiner) {
+    _flow_refiner = std::make_unique<FlowRefiner>(_hg, omp_get_max_threads());
+  }
+  double max_area = _total_area * (1 + _balance_factor) / 2;
 
-  for(auto&& s_n: _nets) {
-    Net* n = s_n.second;
+  int64_t prev_weight = _cut_weight;
 
-    std::array<int, 2> pars{0, 0};
-    for(auto* c: n->get_cells()) {
+  for(; _flow_alpha >= 1; _flow_alpha /= 2) {
+    auto& moves = _flow_refiner->refine(_pars, _cut_nets, _area_in_partition, max_area, _flow_alpha);
 
-      switch(c->get_partition()) {
-        case Partition::A:
-          ++pars[0];
-          break;
-        case Partition::B:
-          ++pars[1];
-          break;
+    size_t num_applied{0};
+    for(auto& cells: moves) {
+      if(cells.empty()) {
+        continue;
       }
 
-      if(pars[0] != 0 && pars[1] != 0) {
-        ++_cut_size;
-        break;
+      int64_t weight = _cut_weight;
+      for(auto* c: cells) {
+        _move(c);
+      }
+
+      if(
+        _cut_weight >= weight ||
+        _area_in_partition[0] >= max_area || _area_in_partition[1] >= max_area
+      ) {
+        for(auto* c: cells) {
+          _move(c);
+        }
+      }
+      else {
+        ++num_applied;
       }
     }
 
+    _log << "flow refinement (alpha " << _flow_alpha << "): "
+         << num_applied << "/" << moves.size() << " corridors applied, cut size "
+         << _cut_nets.size() << "\n";
+
+    if(num_applied != 0) {
+      break;
+    }
+  }
+
+  _caculate_cut_size();
+  return _cut_weight < prev_weight;
+}
+
+// one pass of F-M over disjoint regions run concurrently. the regions saw the
+// cut before any of them moved, so every move prefix is replayed on the real
+// state and cut back to its best balanced point.
+inline
+void Circuit::_refine_domains() {
+
+  if(!_domain_refiner) {
+    _domain_refiner = std::make_unique<DomainRefiner>(_hg, omp_get_max_threads());
   }
+  double max_area = _total_area * (1 + _balance_factor) / 2;
+
+  auto& moves = _domain_refiner->refine(_pars, _cut_nets, _net_counts, _area_in_partition, max_area);
+
+  size_t num_moves{0};
+  for(auto& cells: moves) {
+    int64_t best_weight = _cut_weight;
+    size_t best_size{0};
+
+    for(size_t k = 0; k < cells.size(); ++k) {
+      _move(cells[k]);
+      if(
+        _cut_weight < best_weight &&
+        _area_in_partition[0] < max_area && _area_in_partition[1] < max_area
+      ) {
+        best_weight = _cut_weight;
+        best_size = k + 1;
+      }
+    }
+
+    for(size_t k = cells.size(); k > best_size; --k) {
+      _move(cells[k - 1]);
+    }
+    num_moves += best_size;
+  }
+
+  _log << moves.size() << " regions, " << num_moves << " moves kept\n";
+}
+
+// cut nets and their weight are maintained incrementally by _move. the cut
+// size is the weight F-M minimizes, the number of cut nets with unit weights.
+inline
+void Circuit::_caculate_cut_size() {
+  _cut_size = static_cast<size_t>(_cut_weight);
 }
 
 } // end of namespace fm =============================================================
@@ -0,0 +1,760 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <fstream>
+#include <random>
+#include <climits>
+#include <cstring>
+#include <cstdint>
+
+#include <algorithm>
+
+#include "circuit.hpp"
+
+namespace fm { // begin of namespace fm =======================================================================
+
+// ==============================================================================
+//
+// Declaration of class PinLists
+//
+// sorted id lists coded with stream-vbyte: the gaps of a list are stored in
+// 1 to 4 bytes each, and the byte lengths are packed 2 bits per gap in control
+// bytes in front of the data. a list is decoded on the fly by for_each.
+// the data is read 4 bytes at a time, so the buffer keeps 3 bytes of padding
+// (little-endian hosts only).
+//
+// ==============================================================================
+
+class PinLists {
+
+  public:
+
+    PinLists();
+
+    // ids should be sorted and unique
+    void append(const uint32_t* ids, size_t size);
+
+    size_t size() const;
+
+    uint32_t get_degree(size_t i) const;
+
+    size_t get_num_bytes() const;
+
+    void shrink_to_fit();
+
+    template <typename F>
+    void for_each(size_t i, F&& f) const;
+
+  private:
+
+    static constexpr std::array<uint32_t, 4> _masks{0xff, 0xffff, 0xffffff, 0xffffffff};
+
+    std::vector<uint8_t> _bytes;
+    std::vector<uint64_t> _offsets;
+    std::vector<uint32_t> _degrees;
+};
+
+// ==============================================================================
+//
+// Definition of class PinLists
+//
+// ==============================================================================
+
+inline
+PinLists::PinLists(): _bytes(3, 0), _offsets{0} {
+}
+
+inline
+void PinLists::append(const uint32_t* ids, size_t size) {
+
+  // drop the padding, it is appended again at the end
+  _bytes.resize(_bytes.size() - 3);
+
+  size_t ctrl = _bytes.size();
+  _bytes.resize(ctrl + (size + 3) / 4, 0);
+
+  uint32_t prev{0};
+  for(size_t i = 0; i < size; ++i) {
+    uint32_t gap = ids[i] - prev;
+    prev = ids[i];
+
+    int len = gap < (1u << 8) ? 1 : gap < (1u << 16) ? 2 : gap < (1u << 24) ? 3 : 4;
+    _bytes[ctrl + i / 4] |= (len - 1) << ((i % 4) * 2);
+    for(int b = 0; b < len; ++b) {
+      _bytes.push_back((gap >> (b * 8)) & 0xff);
+    }
+  }
+
+  _offsets.push_back(_bytes.size());
+  _degrees.push_back(size);
+  _bytes.insert(_bytes.end(), 3, 0);
+}
+
+inline
+size_t PinLists::size() const {
+  return _degrees.size();
+}
+
+inline
+uint32_t PinLists::get_degree(size_t i) const {
+  return _degrees[i];
+}
+
+inline
+size_t PinLists::get_num_bytes() const {
+  return _bytes.capacity() + _offsets.capacity() * sizeof(uint64_t) +
+         _degrees.capacity() * sizeof(uint32_t);
+}
+
+inline
+void PinLists::shrink_to_fit() {
+  _bytes.shrink_to_fit();
+  _offsets.shrink_to_fit();
+  _degrees.shrink_to_fit();
+}
+
+template <typename F>
+void PinLists::for_each(size_t i, F&& f) const {
+  uint32_t n = _degrees[i];
+  const uint8_t* ctrl = _bytes.data() + _offsets[i];
+  const uint8_t* data = ctrl + (n + 3) / 4;
+
+  uint32_t id{0};
+  for(uint32_t k = 0; k < n; ++k) {
+    uint32_t len = (ctrl[k >> 2] >> ((k & 3) * 2)) & 3;
+    uint32_t gap;
+    std::memcpy(&gap, data, 4);
+    data += len + 1;
+    id += gap & _masks[len];
+    f(id);
+  }
+}
+
+// ==============================================================================
+//
+// Declaration of class CompressedHypergraph
+//
+// read-only netlist for designs whose Cell/Net graph does not fit in memory.
+// pins of every net and nets of every cell are kept as PinLists, cell names in
+// one character buffer. nets and cells have unit weights and areas.
+//
+// ==============================================================================
+
+class CompressedHypergraph {
+
+  public:
+
+    CompressedHypergraph(const std::string& input_path);
+
+    const PinLists& get_net_pins() const;
+
+    const PinLists& get_cell_nets() const;
+
+    size_t get_num_cells() const;
+
+    size_t get_num_nets() const;
+
+    size_t get_num_pins() const;
+
+    std::string_view get_name(size_t cell) const;
+
+    float get_balance_factor() const;
+
+    int get_max_gain() const;
+
+    // bytes of pin lists and names
+    size_t get_num_bytes() const;
+
+  private:
+
+    void _parse();
+
+    void _transpose();
+
+    std::string _input_path;
+    PinLists _net_pins;
+    PinLists _cell_nets;
+    std::string _names;
+    std::vector<uint64_t> _name_offsets{0};
+    float _balance_factor;
+    int _max_gain{0};
+    size_t _num_pins{0};
+
+    // pins gathered per pass of _transpose
+    size_t _chunk_size{size_t{1} << 24};
+};
+
+// ==============================================================================
+//
+// Definition of class CompressedHypergraph
+//
+// ==============================================================================
+
+inline
+CompressedHypergraph::CompressedHypergraph(const std::string& input_path): _input_path{input_path} {
+  _parse();
+  _transpose();
+  _net_pins.shrink_to_fit();
+  _cell_nets.shrink_to_fit();
+}
+
+inline
+const PinLists& CompressedHypergraph::get_net_pins() const {
+  return _net_pins;
+}
+
+inline
+const PinLists& CompressedHypergraph::get_cell_nets() const {
+  return _cell_nets;
+}
+
+inline
+size_t CompressedHypergraph::get_num_cells() const {
+  return _name_offsets.size() - 1;
+}
+
+inline
+size_t CompressedHypergraph::get_num_nets() const {
+  return _net_pins.size();
+}
+
+inline
+size_t CompressedHypergraph::get_num_pins() const {
+  return _num_pins;
+}
+
+inline
+std::string_view CompressedHypergraph::get_name(size_t cell) const {
+  return std::string_view(_names).substr(
+    _name_offsets[cell], _name_offsets[cell + 1] - _name_offsets[cell]
+  );
+}
+
+inline
+float CompressedHypergraph::get_balance_factor() const {
+  return _balance_factor;
+}
+
+inline
+int CompressedHypergraph::get_max_gain() const {
+  return _max_gain;
+}
+
+inline
+size_t CompressedHypergraph::get_num_bytes() const {
+  return _net_pins.get_num_bytes() + _cell_nets.get_num_bytes() +
+         _names.capacity() + _name_offsets.capacity() * sizeof(uint64_t);
+}
+
+// nets are encoded as they are read, the name map only lives during parsing
+inline
+void CompressedHypergraph::_parse() {
+  using namespace std::literals::string_literals;
+
+  std::ifstream ifs{_input_path};
+  if(!ifs) {
+    throw std::runtime_error("cannot open the file"s + _input_path);
+  }
+
+  std::string line;
+
+  // first line is balance factor
+  std::getline(ifs, line);
+  _balance_factor = std::stof(line);
+
+  std::unordered_map<std::string, uint32_t> ids;
+  std::vector<uint32_t> pins;
+  std::string token;
+  size_t num_tokens;
+
+  while(std::getline(ifs, line, ';')) {
+    std::stringstream line_stream(line);
+    pins.clear();
+
+    // NET net_name cell_name ...
+    num_tokens = 0;
+    while(line_stream >> token) {
+      if(++num_tokens <= 2) {
+        continue;
+      }
+
+      auto [iter, is_new] = ids.emplace(token, ids.size());
+      if(is_new) {
+        if(ids.size() > UINT32_MAX) {
+          throw std::runtime_error("too many cells for 32-bit ids");
+        }
+        _names += token;
+        _name_offsets.push_back(_names.size());
+      }
+      pins.push_back(iter->second);
+    }
+
+    if(num_tokens < 2) {
+      continue;
+    }
+
+    std::sort(pins.begin(), pins.end());
+    pins.erase(std::unique(pins.begin(), pins.end()), pins.end());
+    _num_pins += pins.size();
+    _net_pins.append(pins.data(), pins.size());
+  }
+
+  _names.shrink_to_fit();
+  _name_offsets.shrink_to_fit();
+}
+
+// nets of every cell, built from the net lists in chunks of cells so at most
+// _chunk_size uncompressed pins are held at a time. nets are scanned in id
+// order, so every cell list comes out sorted.
+inline
+void CompressedHypergraph::_transpose() {
+
+  size_t num_cells = get_num_cells();
+  std::vector<uint32_t> degrees(num_cells, 0);
+  for(size_t n = 0; n < _net_pins.size(); ++n) {
+    _net_pins.for_each(n, [&](uint32_t c) { ++degrees[c]; });
+  }
+
+  std::vector<size_t> offsets;
+  std::vector<uint32_t> nets;
+
+  for(size_t lo = 0; lo < num_cells; ) {
+    size_t hi = lo;
+    size_t num_pins{0};
+    do {
+      num_pins += degrees[hi++];
+    } while(hi < num_cells && num_pins + degrees[hi] <= _chunk_size);
+
+    offsets.assign(hi - lo + 1, 0);
+    for(size_t c = lo; c < hi; ++c) {
+      offsets[c - lo + 1] = offsets[c - lo] + degrees[c];
+    }
+    nets.resize(num_pins);
+
+    for(size_t n = 0; n < _net_pins.size(); ++n) {
+      _net_pins.for_each(n, [&](uint32_t c) {
+        if(c >= lo && c < hi) {
+          nets[offsets[c - lo]++] = n;
+        }
+      });
+    }
+
+    for(size_t c = lo; c < hi; ++c) {
+      _cell_nets.append(nets.data() + offsets[c - lo] - degrees[c], degrees[c]);
+      _max_gain = std::max(_max_gain, static_cast<int>(degrees[c]));
+    }
+
+    lo = hi;
+  }
+}
+
+// ==============================================================================
+//
+// Declaration of class CompressedCircuit
+//
+// F-M on a CompressedHypergraph. cells and nets are plain ids and pin lists are
+// decoded whenever they are visited. gain buckets are intrusive lists over
+// per-cell next/prev arrays, so the per-cell state is a few bytes.
+//
+// ==============================================================================
+
+class CompressedCircuit {
+
+  public:
+
+    CompressedCircuit(const CompressedHypergraph& hypergraph, int enabled);
+
+    void fm();
+
+    void dump(std::ostream& os);
+
+    void set_balance_factor(float balance_factor);
+
+    void set_verbose(bool verbose);
+
+    size_t get_cut_size() const;
+
+    size_t get_num_cells(Partition par) const;
+
+  private:
+
+    static constexpr uint32_t NONE{UINT32_MAX};
+
+    void _initialize_partition();
+
+    void _initialize_nets();
+
+    void _reset_pass();
+
+    void _insert_cell(uint32_t id);
+
+    void _remove_cell(uint32_t id);
+
+    uint32_t _choose_candidate();
+
+    bool _check(uint32_t id) const;
+
+    void _update(uint32_t cand);
+
+    void _move(uint32_t id);
+
+    void _reverse();
+
+    const CompressedHypergraph& _hg;
+
+    float _balance_factor;
+    int _max_gain;
+    int _enabled;
+    size_t _cut_size{0};
+
+    // per-cell state, indexed by cell id
+    std::vector<uint8_t> _pars;
+    std::vector<uint8_t> _is_fixed;
+    std::vector<int32_t> _gains;
+    std::vector<uint32_t> _next;
+    std::vector<uint32_t> _prev;
+
+    // per-net state, indexed by net id
+    std::vector<std::array<uint32_t, 2>> _net_counts;
+
+    // bucket heads of partition a and b indexed by gain + _max_gain,
+    // and the highest bucket that may be non-empty
+    std::array<std::vector<uint32_t>, 2> _heads;
+    std::array<int, 2> _tops{0, 0};
+
+    std::array<size_t, 2> _num_cells_in_partition{0, 0};
+
+    std::vector<std::pair<uint32_t, int>> _cand_gains;
+
+    std::ostream _log{std::cout.rdbuf()};
+};
+
+// ==============================================================================
+//
+// Definition of class CompressedCircuit
+//
+// ==============================================================================
+
+inline
+CompressedCircuit::CompressedCircuit(const CompressedHypergraph& hypergraph, int enabled):
+  _hg{hypergraph},
+  _balance_factor{_hg.get_balance_factor()},
+  _max_gain{_hg.get_max_gain()},
+  _enabled{enabled} {
+}
+
+inline
+void CompressedCircuit::set_balance_factor(float balance_factor) {
+  _balance_factor = balance_factor;
+}
+
+inline
+void CompressedCircuit::set_verbose(bool verbose) {
+  _log.rdbuf(verbose ? std::cout.rdbuf() : nullptr);
+}
+
+inline
+size_t CompressedCircuit::get_cut_size() const {
+  return _cut_size;
+}
+
+inline
+size_t CompressedCircuit::get_num_cells(Partition par) const {
+  return _num_cells_in_partition[par];
+}
+
+inline
+void CompressedCircuit::fm() {
+
+  size_t num_cells = _hg.get_num_cells();
+  _pars.assign(num_cells, Partition::A);
+  _is_fixed.assign(num_cells, false);
+  _gains.assign(num_cells, 0);
+  _next.assign(num_cells, NONE);
+  _prev.assign(num_cells, NONE);
+  _heads[0].assign(_max_gain * 2 + 1, NONE);
+  _heads[1].assign(_max_gain * 2 + 1, NONE);
+
+  _initialize_partition();
+  _initialize_nets();
+
+  // what the Cell/Net graph would take for the pin pointers alone
+  size_t pointer_bytes = 2 * _hg.get_num_pins() * sizeof(void*) +
+                         (num_cells + _hg.get_num_nets()) * sizeof(std::vector<void*>);
+
+  _log << "finish parsing and initializing...\n\n"
+       << "////////////////////////\n"
+       << "Compressed hypergraph: " << _hg.get_num_cells() << " cells, "
+       << _hg.get_num_nets() << " nets, " << _hg.get_num_pins() << " pins\n"
+       << "Pin lists and names: " << _hg.get_num_bytes() / 1048576.0 << " MB "
+       << "(pin pointer lists: " << pointer_bytes / 1048576.0 << " MB)\n"
+       << "Balance factor: " << _balance_factor << "\n"
+       << "Maximum available gain: " << _max_gain << "\n"
+       << "Initial cut size: " << _cut_size << "\n"
+       << "////////////////////////\n";
+
+  size_t prev_cut_size{_cut_size};
+  int MAX_NUM_PASSES{10};
+  if(_enabled == 0) {
+    MAX_NUM_PASSES = 1;
+  }
+  int p{0};
+
+  while(true) {
+
+    _log << "\nPass: " << p++ << "\n";
+
+    int gain{0};
+    _reset_pass();
+
+    uint32_t cand = _choose_candidate();
+    while(cand != NONE) {
+      gain += _gains[cand];
+      _update(cand);
+      _cand_gains.push_back({cand, gain});
+      cand = _choose_candidate();
+    }
+
+    _reverse();
+    float delta = prev_cut_size - _cut_size;
+    float improve = delta / prev_cut_size;
+    _log << "###### current cut size: " << _cut_size << "\n"
+         << "###### improvement compared to previous pass: " << improve << "\n";
+
+    // if improvment less than 5%, terminate the loop
+    if(improve < 0.05f || p == MAX_NUM_PASSES) {
+      break;
+    }
+
+    prev_cut_size = _cut_size;
+  }
+
+  _log << "done.\n\n";
+}
+
+inline
+void CompressedCircuit::dump(std::ostream& os) {
+
+  os << "Cutsize = " << _cut_size << "\n";
+
+  // one partition at a time so no per-partition name list is kept
+  for(int p = 0; p < 2; ++p) {
+    os << "G" << p + 1 << " " << _num_cells_in_partition[p] << "\n";
+    for(size_t c = 0; c < _pars.size(); ++c) {
+      if(_pars[c] == p) {
+        os << _hg.get_name(c) << " ";
+      }
+    }
+    os << ";\n";
+  }
+}
+
+// random
+inline
+void CompressedCircuit::_initialize_partition() {
+  std::random_device rd{};
+  std::mt19937 eng(rd());
+  std::uniform_int_distribution<> distr(0, 1);
+
+  _num_cells_in_partition = {0, 0};
+  for(auto& par: _pars) {
+    par = distr(eng);
+    ++_num_cells_in_partition[par];
+  }
+}
+
+inline
+void CompressedCircuit::_initialize_nets() {
+  auto& net_pins = _hg.get_net_pins();
+  _net_counts.assign(net_pins.size(), {0, 0});
+  _cut_size = 0;
+
+  for(size_t n = 0; n < net_pins.size(); ++n) {
+    auto& counts = _net_counts[n];
+    net_pins.for_each(n, [&](uint32_t c) { ++counts[_pars[c]]; });
+    if(counts[0] != 0 && counts[1] != 0) {
+      ++_cut_size;
+    }
+  }
+}
+
+inline
+void CompressedCircuit::_reset_pass() {
+  _cand_gains.clear();
+  std::fill(_heads[0].begin(), _heads[0].end(), NONE);
+  std::fill(_heads[1].begin(), _heads[1].end(), NONE);
+  _tops = {0, 0};
+
+  auto& cell_nets = _hg.get_cell_nets();
+  for(uint32_t c = 0; c < _pars.size(); ++c) {
+    int from = _pars[c];
+    int to = 1 - from;
+    int gain{0};
+    cell_nets.for_each(c, [&](uint32_t n) {
+      gain += (_net_counts[n][from] == 1) - (_net_counts[n][to] == 0);
+    });
+    _gains[c] = gain;
+    _is_fixed[c] = false;
+    _insert_cell(c);
+  }
+}
+
+inline
+void CompressedCircuit::_insert_cell(uint32_t id) {
+  int par = _pars[id];
+  int idx = _gains[id] + _max_gain;
+  uint32_t head = _heads[par][idx];
+
+  _prev[id] = NONE;
+  _next[id] = head;
+  if(head != NONE) {
+    _prev[head] = id;
+  }
+  _heads[par][idx] = id;
+  _tops[par] = std::max(_tops[par], idx);
+}
+
+inline
+void CompressedCircuit::_remove_cell(uint32_t id) {
+  if(_prev[id] != NONE) {
+    _next[_prev[id]] = _next[id];
+  }
+  else {
+    _heads[_pars[id]][_gains[id] + _max_gain] = _next[id];
+  }
+  if(_next[id] != NONE) {
+    _prev[_next[id]] = _prev[id];
+  }
+}
+
+// same order as Circuit: highest gain first, partition a first on ties
+inline
+uint32_t CompressedCircuit::_choose_candidate() {
+
+  while(true) {
+    for(int par = 0; par < 2; ++par) {
+      while(_tops[par] > 0 && _heads[par][_tops[par]] == NONE) {
+        --_tops[par];
+      }
+    }
+
+    int par = _tops[1] > _tops[0] ? 1 : 0;
+    uint32_t cand = _heads[par][_tops[par]];
+    if(cand == NONE) {
+      par = 1 - par;
+      cand = _heads[par][_tops[par]];
+      if(cand == NONE) {
+        return NONE;
+      }
+    }
+
+    _remove_cell(cand);
+    _is_fixed[cand] = true;
+
+    if(_check(cand)) {
+      return cand;
+    }
+  }
+}
+
+// unit areas, same bound as Circuit::_check
+inline
+bool CompressedCircuit::_check(uint32_t id) const {
+  double total = _pars.size();
+  int from = _pars[id];
+  int to = 1 - from;
+  return
+    (total * (1 - _balance_factor) / 2) < (_num_cells_in_partition[from] - 1.0) &&
+    (_num_cells_in_partition[to] + 1.0) < (total * (1 + _balance_factor) / 2);
+}
+
+// the four cases of Circuit::_update folded into one decode per critical net,
+// buckets are updated as soon as a gain changes
+inline
+void CompressedCircuit::_update(uint32_t cand) {
+  int prev_par = _pars[cand];
+  int prev_to_par = 1 - prev_par;
+
+  _hg.get_cell_nets().for_each(cand, [&](uint32_t n) {
+    uint32_t prev_from = _net_counts[n][prev_par];
+    uint32_t prev_to = _net_counts[n][prev_to_par];
+
+    if(prev_to > 1 && prev_from > 2) {
+      return;
+    }
+
+    _hg.get_net_pins().for_each(n, [&](uint32_t c) {
+      if(_is_fixed[c]) {
+        return;
+      }
+
+      int delta{0};
+      if(prev_to == 0) {
+        ++delta;
+      }
+      else if(prev_to == 1 && _pars[c] != prev_par) {
+        --delta;
+      }
+
+      if(prev_from == 1) {
+        --delta;
+      }
+      else if(prev_from == 2 && _pars[c] == prev_par) {
+        ++delta;
+      }
+
+      if(delta != 0) {
+        _remove_cell(c);
+        _gains[c] += delta;
+        _insert_cell(c);
+      }
+    });
+  });
+
+  _move(cand);
+}
+
+inline
+void CompressedCircuit::_move(uint32_t id) {
+  int prev_par = _pars[id];
+  int to_par = 1 - prev_par;
+  _pars[id] = to_par;
+  --_num_cells_in_partition[prev_par];
+  ++_num_cells_in_partition[to_par];
+
+  _hg.get_cell_nets().for_each(id, [&](uint32_t n) {
+    auto& counts = _net_counts[n];
+    bool was_cut = counts[0] != 0 && counts[1] != 0;
+    --counts[prev_par];
+    ++counts[to_par];
+    bool is_cut = counts[0] != 0 && counts[1] != 0;
+    _cut_size += is_cut;
+    _cut_size -= was_cut;
+  });
+}
+
+// find maximum total gain and reverse
+inline
+void CompressedCircuit::_reverse() {
+  int max{INT_MIN};
+  int max_id{0};
+  for(int i = _cand_gains.size() - 1; i >= 0; --i) {
+    if(_cand_gains[i].second > max) {
+      max = _cand_gains[i].second;
+      max_id = i;
+    }
+  }
+
+  for(int i = _cand_gains.size() - 1; i > max_id; --i) {
+    _move(_cand_gains[i].first);
+  }
+}
+
+} // end of namespace fm =============================================================
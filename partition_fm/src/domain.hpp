@@ -0,0 +1,293 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <random>
+
+#include <algorithm>
+#include <omp.h>
+
+#include "hypergraph.hpp"
+#include "heap.hpp"
+
+namespace fm { // begin of namespace fm =======================================================================
+
+// ==============================================================================
+//
+// Declaration of class DomainRefiner
+//
+// one F-M pass split over disjoint regions. regions are grown by BFS from
+// shuffled cut nets up to #cells / #regions cells each, so together they cover
+// the boundary. every region runs the sequential F-M move loop (gain heaps,
+// hill-climbing, best prefix) on a private copy of the net counts, with cells
+// outside the region fixed and its balance limited to a share of the slack.
+// regions are independent and run concurrently; the caller reconciles the
+// global gains by applying them one at a time.
+//
+// ==============================================================================
+
+class DomainRefiner {
+
+  public:
+
+    DomainRefiner(const Hypergraph& hypergraph, size_t num_regions);
+
+    // best move prefix of every region, empty if a region cannot improve
+    const std::vector<std::vector<Cell*>>& refine(
+      const std::vector<Partition>& pars,
+      const std::vector<Net*>& cut_nets,
+      const std::vector<std::array<size_t, 2>>& net_counts,
+      const std::array<double, 2>& areas,
+      double max_area
+    );
+
+  private:
+
+    void _decompose(const std::vector<Net*>& cut_nets);
+
+    void _fm(size_t r, const std::array<double, 2>& shares);
+
+    const Hypergraph& _hg;
+    size_t _num_regions;
+
+    const std::vector<Partition>* _pars{nullptr};
+    const std::vector<std::array<size_t, 2>>* _net_counts{nullptr};
+
+    // region of every cell (-1 if none) and its index in the region
+    std::vector<int> _owners;
+    std::vector<size_t> _locals;
+
+    // per region: index of every net in the region (-1 if not touched)
+    std::vector<std::vector<int>> _net_locals;
+
+    std::vector<std::vector<Cell*>> _regions;
+    std::vector<std::vector<Cell*>> _moves;
+
+    std::mt19937 _eng{std::random_device{}()};
+};
+
+// ==============================================================================
+//
+// Definition of class DomainRefiner
+//
+// ==============================================================================
+
+inline
+DomainRefiner::DomainRefiner(const Hypergraph& hypergraph, size_t num_regions):
+  _hg{hypergraph},
+  _num_regions{std::max<size_t>(num_regions, 1)},
+  _owners(hypergraph.get_cells().size(), -1),
+  _locals(hypergraph.get_cells().size(), 0),
+  _net_locals(_num_regions, std::vector<int>(hypergraph.get_nets().size(), -1)) {
+}
+
+inline
+const std::vector<std::vector<Cell*>>& DomainRefiner::refine(
+  const std::vector<Partition>& pars,
+  const std::vector<Net*>& cut_nets,
+  const std::vector<std::array<size_t, 2>>& net_counts,
+  const std::array<double, 2>& areas,
+  double max_area
+) {
+  _pars = &pars;
+  _net_counts = &net_counts;
+
+  _decompose(cut_nets);
+
+  // cells of partition a may move to b and take b's slack, and vice versa
+  std::array<double, 2> shares{
+    (max_area - areas[1]) / _regions.size(),
+    (max_area - areas[0]) / _regions.size()
+  };
+
+  _moves.assign(_regions.size(), {});
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(size_t r = 0; r < _regions.size(); ++r) {
+    _fm(r, shares);
+  }
+
+  return _moves;
+}
+
+inline
+void DomainRefiner::_decompose(const std::vector<Net*>& cut_nets) {
+
+  for(auto& region: _regions) {
+    for(auto* c: region) {
+      _owners[c->get_id()] = -1;
+    }
+  }
+  _regions.clear();
+
+  std::vector<Net*> seeds(cut_nets);
+  std::shuffle(seeds.begin(), seeds.end(), _eng);
+
+  size_t cap = (_hg.get_cells().size() + _num_regions - 1) / _num_regions;
+  size_t next_seed{0};
+
+  while(_regions.size() < _num_regions && next_seed < seeds.size()) {
+    _regions.emplace_back();
+    auto& region = _regions.back();
+    int r = _regions.size() - 1;
+
+    auto add = [&](Cell* c) {
+      if(_owners[c->get_id()] == -1 && region.size() < cap) {
+        _owners[c->get_id()] = r;
+        _locals[c->get_id()] = region.size();
+        region.push_back(c);
+      }
+    };
+
+    // a new seed whenever the BFS runs dry before the region is full
+    size_t head{0};
+    while(region.size() < cap) {
+      if(head == region.size()) {
+        if(next_seed == seeds.size()) {
+          break;
+        }
+        for(auto* c: seeds[next_seed++]->get_cells()) {
+          add(c);
+        }
+        continue;
+      }
+      for(auto* n: region[head++]->get_nets()) {
+        for(auto* c: n->get_cells()) {
+          add(c);
+        }
+      }
+    }
+
+    if(region.empty()) {
+      _regions.pop_back();
+    }
+  }
+}
+
+// sequential F-M move loop restricted to region r, same candidate order and
+// tie-breaking as Circuit with heaps
+inline
+void DomainRefiner::_fm(size_t r, const std::array<double, 2>& shares) {
+  auto& cells = _regions[r];
+  auto& net_locals = _net_locals[r];
+  size_t m = cells.size();
+
+  std::vector<Net*> nets;
+  std::vector<std::array<size_t, 2>> counts;
+  for(auto* c: cells) {
+    for(auto* n: c->get_nets()) {
+      if(net_locals[n->get_id()] == -1) {
+        net_locals[n->get_id()] = nets.size();
+        nets.push_back(n);
+        counts.push_back((*_net_counts)[n->get_id()]);
+      }
+    }
+  }
+
+  std::vector<Partition> pars(m);
+  std::vector<int> gains(m, 0);
+  std::vector<char> is_fixed(m, false);
+  std::array<GainHeap, 2> heaps;
+  heaps[0].initialize(gains);
+  heaps[1].initialize(gains);
+
+  for(size_t i = 0; i < m; ++i) {
+    pars[i] = (*_pars)[cells[i]->get_id()];
+    int from = pars[i];
+    int to = 1 - from;
+    for(auto* n: cells[i]->get_nets()) {
+      auto& cnt = counts[net_locals[n->get_id()]];
+      if(cnt[from] == 1) {
+        gains[i] += n->get_weight();
+      }
+      if(cnt[to] == 0) {
+        gains[i] -= n->get_weight();
+      }
+    }
+    heaps[pars[i]].push(i);
+  }
+
+  auto local = [&](Cell* c) -> int {
+    return _owners[c->get_id()] == static_cast<int>(r) ? static_cast<int>(_locals[c->get_id()]) : -1;
+  };
+
+  // area moved into b (negative if into a)
+  double delta{0};
+  int gain{0};
+  int best_gain{0};
+  size_t best_size{0};
+  std::vector<Cell*> moved;
+
+  while(!heaps[0].empty() || !heaps[1].empty()) {
+    int par = 0;
+    if(heaps[0].empty() || (!heaps[1].empty() && gains[heaps[1].top()] > gains[heaps[0].top()])) {
+      par = 1;
+    }
+
+    size_t cand = heaps[par].pop();
+    is_fixed[cand] = true;
+
+    double area = cells[cand]->get_area();
+    if(par == Partition::A ? (delta + area >= shares[0]) : (area - delta >= shares[1])) {
+      continue;
+    }
+
+    // the four gain-update cases of Circuit::_update on the local counts
+    int prev_par = pars[cand];
+    int prev_to_par = 1 - prev_par;
+    for(auto* n: cells[cand]->get_nets()) {
+      auto& cnt = counts[net_locals[n->get_id()]];
+      size_t prev_from = cnt[prev_par];
+      size_t prev_to = cnt[prev_to_par];
+      int w = n->get_weight();
+
+      if(prev_to <= 1 || prev_from <= 2) {
+        for(auto* c: n->get_cells()) {
+          int i = local(c);
+          if(i == -1 || is_fixed[i]) {
+            continue;
+          }
+
+          int old_gain = gains[i];
+          if(prev_to == 0) {
+            gains[i] += w;
+          }
+          else if(prev_to == 1 && pars[i] != prev_par) {
+            gains[i] -= w;
+          }
+          if(prev_from == 1) {
+            gains[i] -= w;
+          }
+          else if(prev_from == 2 && pars[i] == prev_par) {
+            gains[i] += w;
+          }
+          if(gains[i] != old_gain) {
+            heaps[pars[i]].update(i);
+          }
+        }
+      }
+
+      --cnt[prev_par];
+      ++cnt[prev_to_par];
+    }
+
+    pars[cand] = static_cast<Partition>(prev_to_par);
+    delta += (prev_to_par == Partition::B ? area : -area);
+    gain += gains[cand];
+    moved.push_back(cells[cand]);
+
+    if(gain > best_gain) {
+      best_gain = gain;
+      best_size = moved.size();
+    }
+  }
+
+  moved.resize(best_size);
+  _moves[r] = std::move(moved);
+
+  for(auto* n: nets) {
+    net_locals[n->get_id()] = -1;
+  }
+}
+
+} // end of namespace fm =============================================================
@@ -0,0 +1,472 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include <algorithm>
+#include <omp.h>
+
+#include "hypergraph.hpp"
+
+namespace fm { // begin of namespace fm =======================================================================
+
+// ==============================================================================
+//
+// Declaration of class PushRelabel
+//
+// FIFO push-relabel with global relabeling. only the first phase (maximum
+// preflow) is run: its value is the max-flow value, and the nodes that can
+// still reach the sink form the smallest sink side of a minimum cut.
+//
+// ==============================================================================
+
+class PushRelabel {
+
+  public:
+
+    PushRelabel(size_t num_nodes);
+
+    void add_edge(size_t u, size_t v, int64_t cap);
+
+    int64_t max_preflow(size_t s, size_t t);
+
+    // valid after max_preflow
+    bool reaches_sink(size_t u) const;
+
+  private:
+
+    void _build();
+
+    void _global_relabel(size_t s, size_t t);
+
+    size_t _num_nodes;
+
+    // edges as added, then arcs in CSR (every edge has a reverse arc)
+    std::vector<std::array<size_t, 2>> _edges;
+    std::vector<int64_t> _edge_caps;
+
+    std::vector<size_t> _offsets;
+    std::vector<size_t> _heads;
+    std::vector<size_t> _revs;
+    std::vector<int64_t> _caps;
+
+    std::vector<size_t> _heights;
+    std::vector<int64_t> _excess;
+    std::vector<size_t> _current;
+};
+
+// ==============================================================================
+//
+// Definition of class PushRelabel
+//
+// ==============================================================================
+
+inline
+PushRelabel::PushRelabel(size_t num_nodes): _num_nodes{num_nodes} {
+}
+
+inline
+void PushRelabel::add_edge(size_t u, size_t v, int64_t cap) {
+  _edges.push_back({u, v});
+  _edge_caps.push_back(cap);
+}
+
+inline
+bool PushRelabel::reaches_sink(size_t u) const {
+  return _heights[u] < _num_nodes;
+}
+
+inline
+void PushRelabel::_build() {
+  _offsets.assign(_num_nodes + 1, 0);
+  for(auto& [u, v]: _edges) {
+    ++_offsets[u + 1];
+    ++_offsets[v + 1];
+  }
+  for(size_t u = 0; u < _num_nodes; ++u) {
+    _offsets[u + 1] += _offsets[u];
+  }
+
+  std::vector<size_t> pos(_offsets.begin(), _offsets.end() - 1);
+  _heads.resize(_offsets.back());
+  _revs.resize(_offsets.back());
+  _caps.resize(_offsets.back());
+
+  for(size_t e = 0; e < _edges.size(); ++e) {
+    auto [u, v] = _edges[e];
+    size_t a = pos[u]++;
+    size_t b = pos[v]++;
+    _heads[a] = v;
+    _caps[a] = _edge_caps[e];
+    _revs[a] = b;
+    _heads[b] = u;
+    _caps[b] = 0;
+    _revs[b] = a;
+  }
+}
+
+// exact distances to the sink in the residual graph,
+// nodes that cannot reach the sink get height _num_nodes
+inline
+void PushRelabel::_global_relabel(size_t s, size_t t) {
+  _heights.assign(_num_nodes, _num_nodes);
+  _heights[t] = 0;
+
+  std::vector<size_t> queue{t};
+  for(size_t i = 0; i < queue.size(); ++i) {
+    size_t v = queue[i];
+    for(size_t a = _offsets[v]; a < _offsets[v + 1]; ++a) {
+      size_t u = _heads[a];
+      if(u != s && _heights[u] == _num_nodes && _caps[_revs[a]] > 0) {
+        _heights[u] = _heights[v] + 1;
+        queue.push_back(u);
+      }
+    }
+  }
+
+  _heights[s] = _num_nodes;
+  _current.assign(_offsets.begin(), _offsets.end() - 1);
+}
+
+inline
+int64_t PushRelabel::max_preflow(size_t s, size_t t) {
+  _build();
+  _excess.assign(_num_nodes, 0);
+  _global_relabel(s, t);
+
+  std::vector<size_t> active;
+  size_t head{0};
+
+  auto push = [&](size_t v, size_t a, int64_t delta) {
+    size_t u = _heads[a];
+    _caps[a] -= delta;
+    _caps[_revs[a]] += delta;
+    _excess[v] -= delta;
+    if(_excess[u] == 0 && u != s && u != t) {
+      active.push_back(u);
+    }
+    _excess[u] += delta;
+  };
+
+  for(size_t a = _offsets[s]; a < _offsets[s + 1]; ++a) {
+    if(_caps[a] > 0) {
+      push(s, a, _caps[a]);
+    }
+  }
+
+  size_t work{0};
+  size_t relabel_period = 6 * _num_nodes + _heads.size() / 2;
+
+  while(head < active.size()) {
+    size_t v = active[head++];
+
+    while(_excess[v] > 0 && _heights[v] < _num_nodes) {
+      if(_current[v] == _offsets[v + 1]) {
+        size_t h = _num_nodes;
+        for(size_t a = _offsets[v]; a < _offsets[v + 1]; ++a) {
+          if(_caps[a] > 0) {
+            h = std::min(h, _heights[_heads[a]] + 1);
+          }
+        }
+        _heights[v] = h;
+        _current[v] = _offsets[v];
+        work += _offsets[v + 1] - _offsets[v] + 12;
+        continue;
+      }
+
+      size_t a = _current[v];
+      if(_caps[a] > 0 && _heights[v] == _heights[_heads[a]] + 1) {
+        push(v, a, std::min(_excess[v], _caps[a]));
+      }
+      else {
+        ++_current[v];
+      }
+    }
+
+    if(work > relabel_period) {
+      _global_relabel(s, t);
+      work = 0;
+    }
+
+    // compact the queue once the consumed prefix dominates
+    if(head > 1024 && head * 2 > active.size()) {
+      active.erase(active.begin(), active.begin() + head);
+      head = 0;
+    }
+  }
+
+  _global_relabel(s, t);
+  return _excess[t];
+}
+
+// ==============================================================================
+//
+// Declaration of class FlowRefiner
+//
+// flow-based refinement of a bipartition. corridors of cells around the cut are
+// grown by BFS from cut nets, each side limited by the area the other
+// partition can still take. every corridor is turned into a flow network by
+// Lawler expansion (one capacity-w edge per net), cells outside the corridor are
+// contracted into the source (partition a) or the sink (partition b), and a
+// minimum cut is computed by push-relabel. corridors are disjoint and solved
+// concurrently; the caller applies and verifies the moves one corridor at a time.
+//
+// ==============================================================================
+
+class FlowRefiner {
+
+  public:
+
+    FlowRefiner(const Hypergraph& hypergraph, size_t num_corridors);
+
+    // cells to move for every corridor, empty if a corridor cannot improve.
+    // a corridor may take alpha times its share of the slack, its cut is only
+    // kept if the moved area fits the share.
+    const std::vector<std::vector<Cell*>>& refine(
+      const std::vector<Partition>& pars,
+      const std::vector<Net*>& cut_nets,
+      const std::array<double, 2>& areas,
+      double max_area,
+      double alpha
+    );
+
+  private:
+
+    void _grow(size_t i, Net* seed, const std::array<double, 2>& budgets);
+
+    void _solve(size_t i, const std::array<double, 2>& shares);
+
+    const Hypergraph& _hg;
+    size_t _num_corridors;
+
+    const std::vector<Partition>* _pars{nullptr};
+
+    // corridor of every cell (-1 if none) and its index in the corridor
+    std::vector<int> _owners;
+    std::vector<size_t> _locals;
+
+    std::vector<std::vector<Cell*>> _corridors;
+    std::vector<std::vector<Cell*>> _moves;
+};
+
+// ==============================================================================
+//
+// Definition of class FlowRefiner
+//
+// ==============================================================================
+
+inline
+FlowRefiner::FlowRefiner(const Hypergraph& hypergraph, size_t num_corridors):
+  _hg{hypergraph},
+  _num_corridors{std::max<size_t>(num_corridors, 1)},
+  _owners(hypergraph.get_cells().size(), -1),
+  _locals(hypergraph.get_cells().size(), 0) {
+}
+
+inline
+const std::vector<std::vector<Cell*>>& FlowRefiner::refine(
+  const std::vector<Partition>& pars,
+  const std::vector<Net*>& cut_nets,
+  const std::array<double, 2>& areas,
+  double max_area,
+  double alpha
+) {
+  _pars = &pars;
+
+  for(auto& corridor: _corridors) {
+    for(auto* c: corridor) {
+      _owners[c->get_id()] = -1;
+    }
+  }
+  _corridors.clear();
+  _moves.clear();
+
+  // cells of partition a may move to b and take b's slack, and vice versa
+  std::array<double, 2> shares{
+    (max_area - areas[1]) / _num_corridors,
+    (max_area - areas[0]) / _num_corridors
+  };
+  std::array<double, 2> budgets{alpha * shares[0], alpha * shares[1]};
+
+  for(auto* n: cut_nets) {
+    if(_corridors.size() == _num_corridors) {
+      break;
+    }
+
+    auto& cells = n->get_cells();
+    bool is_free = std::none_of(cells.begin(), cells.end(), [this](Cell* c) {
+      return _owners[c->get_id()] != -1;
+    });
+    if(is_free) {
+      _corridors.emplace_back();
+      _grow(_corridors.size() - 1, n, budgets);
+    }
+  }
+
+  _moves.resize(_corridors.size());
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(size_t i = 0; i < _corridors.size(); ++i) {
+    _solve(i, shares);
+  }
+
+  return _moves;
+}
+
+// BFS over pins, stops once both sides have run out of budget
+inline
+void FlowRefiner::_grow(size_t i, Net* seed, const std::array<double, 2>& budgets) {
+  auto& corridor = _corridors[i];
+  std::array<double, 2> taken{0, 0};
+  std::array<bool, 2> full{false, false};
+
+  auto add = [&](Cell* c) {
+    size_t id = c->get_id();
+    int side = (*_pars)[id];
+    if(_owners[id] != -1 || full[side]) {
+      return;
+    }
+    if(taken[side] + c->get_area() > budgets[side]) {
+      full[side] = true;
+      return;
+    }
+    taken[side] += c->get_area();
+    _owners[id] = i;
+    _locals[id] = corridor.size();
+    corridor.push_back(c);
+  };
+
+  for(auto* c: seed->get_cells()) {
+    add(c);
+  }
+
+  for(size_t k = 0; k < corridor.size() && !(full[0] && full[1]); ++k) {
+    for(auto* n: corridor[k]->get_nets()) {
+      for(auto* c: n->get_cells()) {
+        add(c);
+      }
+    }
+  }
+}
+
+// nodes: 0 source, 1 sink, corridor cells, then an (in, out) pair per net
+inline
+void FlowRefiner::_solve(size_t i, const std::array<double, 2>& shares) {
+  auto& corridor = _corridors[i];
+  auto& pars = *_pars;
+
+  std::vector<Net*> nets;
+  for(auto* c: corridor) {
+    for(auto* n: c->get_nets()) {
+      nets.push_back(n);
+    }
+  }
+  std::sort(nets.begin(), nets.end(), [](Net* a, Net* b) { return a->get_id() < b->get_id(); });
+  nets.erase(std::unique(nets.begin(), nets.end()), nets.end());
+
+  size_t base = 2 + corridor.size();
+  std::vector<std::array<size_t, 2>> pins;
+  std::vector<std::array<size_t, 3>> edges;
+  int64_t inf{1};
+  int64_t cut{0};
+
+  for(size_t j = 0; j < nets.size(); ++j) {
+    auto* n = nets[j];
+    bool to_source{false};
+    bool to_sink{false};
+    std::array<bool, 2> spans{false, false};
+    size_t num_pins{0};
+
+    for(auto* c: n->get_cells()) {
+      size_t id = c->get_id();
+      spans[pars[id]] = true;
+      if(_owners[id] == static_cast<int>(i)) {
+        ++num_pins;
+      }
+      else if(pars[id] == Partition::A) {
+        to_source = true;
+      }
+      else {
+        to_sink = true;
+      }
+    }
+
+    // cut by any corridor cut, or never cut
+    if((to_source && to_sink) || n->get_cells().size() < 2) {
+      continue;
+    }
+
+    int64_t w = n->get_weight();
+    inf += w;
+    if(spans[0] && spans[1]) {
+      cut += w;
+    }
+
+    size_t in = base + 2 * j;
+    size_t out = in + 1;
+    edges.push_back({in, out, static_cast<size_t>(w)});
+    if(to_source) {
+      pins.push_back({0, in});
+    }
+    if(to_sink) {
+      pins.push_back({out, 1});
+    }
+    for(auto* c: n->get_cells()) {
+      if(_owners[c->get_id()] == static_cast<int>(i)) {
+        size_t v = 2 + _locals[c->get_id()];
+        pins.push_back({v, in});
+        pins.push_back({out, v});
+      }
+    }
+  }
+
+  // largest source side from the forward network,
+  // smallest source side from the reversed one
+  std::array<PushRelabel, 2> flows{PushRelabel(base + 2 * nets.size()), PushRelabel(base + 2 * nets.size())};
+  for(auto& [u, v, w]: edges) {
+    flows[0].add_edge(u, v, w);
+    flows[1].add_edge(v, u, w);
+  }
+  for(auto& [u, v]: pins) {
+    flows[0].add_edge(u, v, inf);
+    flows[1].add_edge(v, u, inf);
+  }
+
+  int64_t value = flows[0].max_preflow(0, 1);
+  if(value >= cut) {
+    return;
+  }
+
+  // moved area into b (negative if into a), checked against the shares
+  auto split = [&](int r, double& delta) {
+    std::vector<Cell*> moves;
+    delta = 0;
+    for(auto* c: corridor) {
+      size_t v = 2 + _locals[c->get_id()];
+      bool to_a = (r == 0) ? !flows[0].reaches_sink(v) : flows[1].reaches_sink(v);
+      Partition to = to_a ? Partition::A : Partition::B;
+      if(to != pars[c->get_id()]) {
+        moves.push_back(c);
+        delta += (to == Partition::B ? c->get_area() : -c->get_area());
+      }
+    }
+    return moves;
+  };
+
+  // the reversed network is only solved if the largest source side does not fit
+  double delta;
+  auto moves = split(0, delta);
+  if(delta < shares[0] && -delta < shares[1]) {
+    _moves[i] = std::move(moves);
+    return;
+  }
+
+  flows[1].max_preflow(1, 0);
+  moves = split(1, delta);
+  if(delta < shares[0] && -delta < shares[1]) {
+    _moves[i] = std::move(moves);
+  }
+}
+
+} // end of namespace fm =============================================================
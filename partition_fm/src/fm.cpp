@@ -0,0 +1,62 @@
+#include "fm.hpp"
+#include "circuit.hpp"
+#include "spectral.hpp"
+
+#include <chrono>
+
+namespace fm { // begin of namespace fm =======================================================================
+
+Result partition(const Hypergraph& hypergraph, const Options& options) {
+
+  auto tic = std::chrono::steady_clock::now();
+
+  Circuit circuit(hypergraph, options.enabled);
+  circuit.set_boundary(options.boundary);
+  circuit.set_heap(options.heap);
+  circuit.set_flow(options.flow);
+  circuit.set_parallel(options.parallel);
+  circuit.set_adaptive_stop(options.adaptive_stop);
+  circuit.set_max_fruitless_moves(options.max_fruitless_moves);
+  circuit.set_verbose(options.verbose);
+  if(options.balance_factor >= 0) {
+    circuit.set_balance_factor(options.balance_factor);
+  }
+
+  Spectral spectral_init(hypergraph);
+  if(options.spectral) {
+    spectral_init.apply();
+    circuit.set_initial_partition([&spectral_init](const Cell& cell) {
+      return static_cast<Partition>(spectral_init.get_partition()[cell.get_id()]);
+    });
+  }
+
+  circuit.fm();
+
+  auto toc = std::chrono::steady_clock::now();
+
+  Result result;
+  auto& pars = circuit.get_partition();
+  result.partition.assign(pars.begin(), pars.end());
+  result.cut_size = circuit.get_cut_size();
+  result.initial_cut_size = circuit.get_initial_cut_size();
+  result.num_passes = circuit.get_num_passes();
+  result.num_cells = {circuit.get_num_cells(Partition::A), circuit.get_num_cells(Partition::B)};
+  result.areas = {circuit.get_area(Partition::A), circuit.get_area(Partition::B)};
+  result.runtime = std::chrono::duration<double>(toc - tic).count();
+
+  return result;
+}
+
+Result partition(
+  size_t num_cells,
+  const std::vector<size_t>& pin_offsets,
+  const std::vector<size_t>& pin_ids,
+  const std::vector<int>& net_weights,
+  const std::vector<double>& cell_areas,
+  const Options& options
+) {
+  Hypergraph hypergraph(num_cells, pin_offsets, pin_ids, net_weights, cell_areas);
+  return partition(hypergraph, options);
+}
+
+} // end of namespace fm =============================================================
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <array>
+
+#include "hypergraph.hpp"
+
+namespace fm { // begin of namespace fm =======================================================================
+
+// ==============================================================================
+//
+// In-memory partitioning API
+//
+// partitions a hypergraph given as arrays and returns the partition and its
+// statistics, so a flow can embed F-M without files or a child process.
+//
+// ==============================================================================
+
+struct Options {
+
+  // 1 -> multiple passes, 0 -> single pass
+  int enabled{1};
+
+  // negative -> use the balance factor of the hypergraph
+  float balance_factor{-1};
+
+  bool boundary{false};
+
+  bool heap{false};
+
+  // flow refinement on the cut region once F-M stops improving
+  bool flow{false};
+
+  // F-M passes on disjoint regions, one per OpenMP thread
+  bool parallel{false};
+
+  // Fiedler vector split as the initial partition instead of a random one
+  bool spectral{false};
+
+  // stop a pass early by the adaptive rule (alpha, 0 -> off) or after this
+  // many moves without a new best prefix (0 -> off)
+  double adaptive_stop{0};
+  size_t max_fruitless_moves{0};
+
+  // per-pass log on stdout
+  bool verbose{false};
+};
+
+struct Result {
+
+  // 0 -> partition a, 1 -> partition b, indexed by cell id
+  std::vector<int> partition;
+
+  size_t cut_size{0};
+
+  size_t initial_cut_size{0};
+
+  size_t num_passes{0};
+
+  std::array<size_t, 2> num_cells{0, 0};
+
+  std::array<double, 2> areas{0, 0};
+
+  // seconds spent in partitioning (initial partition included)
+  double runtime{0};
+};
+
+Result partition(const Hypergraph& hypergraph, const Options& options = {});
+
+// pins of net i are pin_ids[pin_offsets[i], pin_offsets[i + 1]),
+// empty weights/areas mean unit weights/areas
+Result partition(
+  size_t num_cells,
+  const std::vector<size_t>& pin_offsets,
+  const std::vector<size_t>& pin_ids,
+  const std::vector<int>& net_weights = {},
+  const std::vector<double>& cell_areas = {},
+  const Options& options = {}
+);
+
+} // end of namespace fm =============================================================
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+namespace fm { // begin of namespace fm =======================================================================
+
+// ==============================================================================
+//
+// Declaration of class GainHeap
+//
+// addressable 4-ary max-heap of cell ids keyed by their gains
+// used instead of buckets when gains are weighted and no longer small integers
+//
+// ==============================================================================
+
+class GainHeap {
+
+  public:
+
+    void initialize(const std::vector<int>& gains);
+
+    bool empty() const;
+
+    size_t size() const;
+
+    size_t top() const;
+
+    size_t pop();
+
+    void push(size_t id);
+
+    void erase(size_t id);
+
+    void update(size_t id);
+
+    void clear();
+
+  private:
+
+    void _sift_up(size_t idx);
+
+    void _sift_down(size_t idx);
+
+    void _place(size_t idx, size_t id);
+
+    const std::vector<int>* _gains{nullptr};
+    std::vector<size_t> _heap;
+    std::vector<size_t> _pos;
+};
+
+// ==============================================================================
+//
+// Definition of class GainHeap
+//
+// ==============================================================================
+
+inline
+void GainHeap::initialize(const std::vector<int>& gains) {
+  _gains = &gains;
+  _heap.clear();
+  _pos.resize(gains.size());
+}
+
+inline
+bool GainHeap::empty() const {
+  return _heap.empty();
+}
+
+inline
+size_t GainHeap::size() const {
+  return _heap.size();
+}
+
+inline
+size_t GainHeap::top() const {
+  return _heap.front();
+}
+
+inline
+size_t GainHeap::pop() {
+  size_t id = _heap.front();
+  erase(id);
+  return id;
+}
+
+inline
+void GainHeap::push(size_t id) {
+  _heap.push_back(id);
+  _place(_heap.size() - 1, id);
+  _sift_up(_heap.size() - 1);
+}
+
+inline
+void GainHeap::erase(size_t id) {
+  size_t idx = _pos[id];
+  size_t last = _heap.back();
+  _heap.pop_back();
+
+  if(idx < _heap.size()) {
+    _place(idx, last);
+    update(last);
+  }
+}
+
+// restore heap order after the gain of id changed
+inline
+void GainHeap::update(size_t id) {
+  size_t idx = _pos[id];
+  if(idx > 0 && (*_gains)[_heap[(idx - 1) / 4]] < (*_gains)[id]) {
+    _sift_up(idx);
+  }
+  else {
+    _sift_down(idx);
+  }
+}
+
+inline
+void GainHeap::clear() {
+  _heap.clear();
+}
+
+inline
+void GainHeap::_place(size_t idx, size_t id) {
+  _heap[idx] = id;
+  _pos[id] = idx;
+}
+
+inline
+void GainHeap::_sift_up(size_t idx) {
+  size_t id = _heap[idx];
+  int gain = (*_gains)[id];
+  while(idx > 0) {
+    size_t parent = (idx - 1) / 4;
+    if((*_gains)[_heap[parent]] >= gain) {
+      break;
+    }
+    _place(idx, _heap[parent]);
+    idx = parent;
+  }
+  _place(idx, id);
+}
+
+inline
+void GainHeap::_sift_down(size_t idx) {
+  size_t id = _heap[idx];
+  int gain = (*_gains)[id];
+  size_t n = _heap.size();
+  while(true) {
+    size_t first = idx * 4 + 1;
+    if(first >= n) {
+      break;
+    }
+
+    size_t last = std::min(first + 4, n);
+    size_t max_child = first;
+    for(size_t i = first + 1; i < last; ++i) {
+      if((*_gains)[_heap[i]] > (*_gains)[_heap[max_child]]) {
+        max_child = i;
+      }
+    }
+
+    if((*_gains)[_heap[max_child]] <= gain) {
+      break;
+    }
+    _place(idx, _heap[max_child]);
+    idx = max_child;
+  }
+  _place(idx, id);
+}
+
+} // end of namespace fm =============================================================
@@ -0,0 +1,495 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <filesystem>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "utility.hpp"
+
+namespace fm { // begin of namespace fm =======================================================================
+
+enum Partition {
+  A = 0,
+  B
+};
+
+class Cell;
+class Net;
+class Hypergraph;
+
+// ==============================================================================
+//
+// Declaration of class Net
+//
+// ==============================================================================
+
+class Net {
+
+  friend class Hypergraph;
+
+  public:
+
+    Net(const std::string& name, size_t id);
+
+    const std::vector<Cell*>& get_cells() const;
+
+    const std::string& get_name() const;
+
+    size_t get_id() const;
+
+    int get_weight() const;
+
+    void add_cell(Cell* cell);
+
+  private:
+
+    std::string _name;
+    size_t _id;
+    std::vector<Cell*> _connected_cells;
+    int _weight{1};
+
+    // TODO: should we pre-find critical path?
+    //bool _is_critical{false};
+};
+
+// ==============================================================================
+//
+// Definition of class Net
+//
+// ==============================================================================
+
+inline
+Net::Net(const std::string& name, size_t id): _name{name}, _id{id} {
+}
+
+inline
+const std::vector<Cell*>& Net::get_cells() const {
+  return _connected_cells;
+}
+
+inline
+const std::string& Net::get_name() const {
+  return _name;
+}
+
+inline
+size_t Net::get_id() const {
+  return _id;
+}
+
+inline
+int Net::get_weight() const {
+  return _weight;
+}
+
+inline
+void Net::add_cell(Cell* cell) {
+  _connected_cells.push_back(cell);
+  return;
+}
+
+// ==============================================================================
+//
+// Declaration of class Cell
+//
+// ==============================================================================
+
+class Cell {
+
+  friend class Hypergraph;
+
+  public:
+
+    Cell(const std::string& name, size_t id);
+
+    const std::vector<Net*>& get_nets() const;
+
+    const std::string& get_name() const;
+
+    size_t get_id() const;
+
+    double get_area() const;
+
+    void add_net(Net*);
+
+  private:
+
+    std::string _name;
+    size_t _id;
+    std::vector<Net*> _nets;
+    double _area{1};
+};
+
+// ==============================================================================
+//
+// Definition of class Cell
+//
+// ==============================================================================
+
+
+inline
+Cell::Cell(const std::string& name, size_t id): _name{name}, _id{id} {
+}
+
+inline
+const std::vector<Net*>& Cell::get_nets() const {
+  return _nets;
+}
+
+inline
+const std::string& Cell::get_name() const {
+  return _name;
+}
+
+inline
+size_t Cell::get_id() const {
+  return _id;
+}
+
+inline
+double Cell::get_area() const {
+  return _area;
+}
+
+inline
+void Cell::add_net(Net* net) {
+  _nets.push_back(net);
+  return;
+}
+
+// ==============================================================================
+//
+// Declaration of class Hypergraph
+//
+// read-only netlist shared by every Circuit partitioning it.
+// cells and nets are indexed by id, so per-run state lives in plain arrays.
+//
+// ==============================================================================
+
+class Hypergraph {
+
+  public:
+
+    Hypergraph(const std::string& input_path);
+
+    // in-memory netlist: pins of net i are pin_ids[pin_offsets[i], pin_offsets[i + 1]),
+    // empty weights/areas mean unit weights/areas.
+    // cells are named c<id> and nets n<id>.
+    Hypergraph(
+      size_t num_cells,
+      const std::vector<size_t>& pin_offsets,
+      const std::vector<size_t>& pin_ids,
+      const std::vector<int>& net_weights = {},
+      const std::vector<double>& cell_areas = {},
+      float balance_factor = 0.1f
+    );
+
+    ~Hypergraph();
+
+    Hypergraph(const Hypergraph&) = delete;
+    Hypergraph& operator= (const Hypergraph&) = delete;
+
+    void read_cell_areas(const std::string& path);
+
+    void read_net_weights(const std::string& path);
+
+    const std::vector<Cell*>& get_cells() const;
+
+    const std::vector<Net*>& get_nets() const;
+
+    // nullptr if no such cell
+    Cell* get_cell(const std::string& name) const;
+
+    float get_balance_factor() const;
+
+    int get_max_gain() const;
+
+    double get_total_area() const;
+
+    bool is_weighted() const;
+
+  private:
+
+    void _parse();
+
+    void _set_max_gain();
+
+    std::filesystem::path _input_path;
+    std::vector<Net*> _nets;
+    std::vector<Cell*> _cells;
+    std::unordered_map<std::string, Net*> _nets_map;
+    std::unordered_map<std::string, Cell*> _cells_map;
+    float _balance_factor;
+    int _max_gain{0};
+    double _total_area{0};
+    bool _is_weighted{false};
+};
+
+// ==============================================================================
+//
+// Definition of class Hypergraph
+//
+// ==============================================================================
+
+inline
+Hypergraph::Hypergraph(const std::string& input_path): _input_path{input_path} {
+  _parse();
+  _set_max_gain();
+  _total_area = _cells.size();
+}
+
+inline
+Hypergraph::Hypergraph(
+  size_t num_cells,
+  const std::vector<size_t>& pin_offsets,
+  const std::vector<size_t>& pin_ids,
+  const std::vector<int>& net_weights,
+  const std::vector<double>& cell_areas,
+  float balance_factor
+): _balance_factor{balance_factor} {
+
+  if(pin_offsets.empty() || pin_offsets.back() != pin_ids.size()) {
+    throw std::invalid_argument("pin_offsets should end with the number of pins");
+  }
+
+  size_t num_nets = pin_offsets.size() - 1;
+  if(!net_weights.empty() && net_weights.size() != num_nets) {
+    throw std::invalid_argument("net_weights should have one entry per net");
+  }
+  if(!cell_areas.empty() && cell_areas.size() != num_cells) {
+    throw std::invalid_argument("cell_areas should have one entry per cell");
+  }
+
+  _cells.reserve(num_cells);
+  for(size_t i = 0; i < num_cells; ++i) {
+    _cells.push_back(new Cell("c" + std::to_string(i), i));
+    _cells_map.insert({_cells.back()->get_name(), _cells.back()});
+  }
+
+  _nets.reserve(num_nets);
+  for(size_t i = 0; i < num_nets; ++i) {
+    if(pin_offsets[i] > pin_offsets[i + 1]) {
+      throw std::invalid_argument("pin_offsets should be non-decreasing");
+    }
+    Net* net = new Net("n" + std::to_string(i), i);
+    _nets.push_back(net);
+    _nets_map.insert({net->get_name(), net});
+    for(size_t p = pin_offsets[i]; p < pin_offsets[i + 1]; ++p) {
+      if(pin_ids[p] >= num_cells) {
+        throw std::invalid_argument("pin id " + std::to_string(pin_ids[p]) + " out of range");
+      }
+      net->add_cell(_cells[pin_ids[p]]);
+      _cells[pin_ids[p]]->add_net(net);
+    }
+  }
+
+  for(size_t i = 0; i < net_weights.size(); ++i) {
+    if(net_weights[i] <= 0) {
+      throw std::invalid_argument("weight of net " + std::to_string(i) + " should be positive");
+    }
+    _nets[i]->_weight = net_weights[i];
+  }
+
+  _total_area = num_cells;
+  if(!cell_areas.empty()) {
+    _total_area = 0;
+    for(size_t i = 0; i < num_cells; ++i) {
+      _cells[i]->_area = cell_areas[i];
+      _total_area += cell_areas[i];
+    }
+  }
+
+  _is_weighted = !net_weights.empty() || !cell_areas.empty();
+  _set_max_gain();
+}
+
+inline
+Hypergraph::~Hypergraph() {
+
+  for(auto* n: _nets) {
+    delete n;
+  }
+
+  for(auto* c: _cells) {
+    delete c;
+  }
+}
+
+inline
+const std::vector<Cell*>& Hypergraph::get_cells() const {
+  return _cells;
+}
+
+inline
+const std::vector<Net*>& Hypergraph::get_nets() const {
+  return _nets;
+}
+
+inline
+Cell* Hypergraph::get_cell(const std::string& name) const {
+  auto iter = _cells_map.find(name);
+  return iter == _cells_map.end() ? nullptr : iter->second;
+}
+
+inline
+float Hypergraph::get_balance_factor() const {
+  return _balance_factor;
+}
+
+inline
+int Hypergraph::get_max_gain() const {
+  return _max_gain;
+}
+
+inline
+double Hypergraph::get_total_area() const {
+  return _total_area;
+}
+
+inline
+bool Hypergraph::is_weighted() const {
+  return _is_weighted;
+}
+
+// each line: cell_name area
+inline
+void Hypergraph::read_cell_areas(const std::string& path) {
+  auto sstream = read_file_to_sstream(path);
+  std::string name;
+  std::string token;
+  double area;
+  char rest;
+
+  // the whole token must be the area, so a malformed line is an error and
+  // not the silent end of the file
+  while(sstream >> name) {
+    std::istringstream token_stream;
+    if(sstream >> token) {
+      token_stream.str(token);
+    }
+    if(!(token_stream >> area) || token_stream >> rest) {
+      throw std::runtime_error("bad area of cell " + name + " in " + path);
+    }
+    auto iter = _cells_map.find(name);
+    if(iter == _cells_map.end()) {
+      throw std::runtime_error("unknown cell " + name + " in " + path);
+    }
+    if(!(area > 0)) {
+      throw std::runtime_error("area of cell " + name + " should be positive");
+    }
+    iter->second->_area = area;
+  }
+
+  _total_area = 0;
+  for(auto* c: _cells) {
+    _total_area += c->_area;
+  }
+
+  _is_weighted = true;
+}
+
+// each line: net_name weight
+// weights are positive integers, so real-valued criticality should be scaled first
+inline
+void Hypergraph::read_net_weights(const std::string& path) {
+  auto sstream = read_file_to_sstream(path);
+  std::string name;
+  std::string token;
+  int weight;
+  char rest;
+
+  while(sstream >> name) {
+    std::istringstream token_stream;
+    if(sstream >> token) {
+      token_stream.str(token);
+    }
+    if(!(token_stream >> weight) || token_stream >> rest) {
+      throw std::runtime_error("bad weight of net " + name + " in " + path);
+    }
+    auto iter = _nets_map.find(name);
+    if(iter == _nets_map.end()) {
+      throw std::runtime_error("unknown net " + name + " in " + path);
+    }
+    if(weight <= 0) {
+      throw std::runtime_error("weight of net " + name + " should be positive");
+    }
+    iter->second->_weight = weight;
+  }
+
+  _set_max_gain();
+  _is_weighted = true;
+}
+
+inline
+void Hypergraph::_parse() {
+  auto sstream = read_file_to_sstream(_input_path);
+  std::string line;
+
+  // first line is balance factor
+  std::getline(sstream, line);
+  _balance_factor = std::stof(line);
+
+  std::vector<std::string> tokens;
+  while(std::getline(sstream, line, ';')) {
+    line.erase(std::remove(line.begin(), line.end(), '\n'), line.cend());
+    std::stringstream line_stream(line);
+    std::string token;
+    tokens.clear();
+
+    line_stream >> std::ws;
+    while(std::getline(line_stream, token, ' ')) {
+      tokens.push_back(token);
+    }
+
+    if(tokens.size() < 2) {
+      continue;
+    }
+
+    // net
+    Net* net = new Net(tokens[1], _nets.size());
+    _nets.push_back(net);
+    _nets_map.insert({net->get_name(), net});
+
+    // cells
+    for(size_t i = 2; i < tokens.size(); ++i) {
+      if(tokens[i] != "") {
+        auto iter = _cells_map.find(tokens[i]);
+        Cell* cell{nullptr};
+
+        if(iter == _cells_map.end()) {
+          cell = new Cell(tokens[i], _cells.size());
+          _cells.push_back(cell);
+          _cells_map.insert({cell->get_name(), cell});
+        }
+        else {
+          cell = (*iter).second;
+        }
+
+        net->add_cell(cell);
+        cell->add_net(net);
+      }
+    }
+  }
+}
+
+inline
+void Hypergraph::_set_max_gain() {
+  _max_gain = 0;
+  for(auto* c: _cells) {
+    int gain{0};
+    for(auto* n: c->get_nets()) {
+      gain += n->get_weight();
+    }
+    _max_gain = std::max(_max_gain, gain);
+  }
+  return;
+}
+
+} // end of namespace fm =============================================================
@@ -0,0 +1,434 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <functional>
+
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <cstring>
+#include <climits>
+
+#include <algorithm>
+
+#include <omp.h>
+#include <sched.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "circuit.hpp"
+
+namespace fm { // begin of namespace fm =======================================================================
+
+// ==============================================================================
+//
+// Declaration of class MultiProcess
+//
+// multi-start F-M in worker processes. the netlist is flattened into an
+// anonymous shared mapping before forking, so it is read by every worker
+// without copies through the parser. every worker pins itself to the CPUs of
+// one NUMA node (split among the workers on the same node) and rebuilds a
+// private Hypergraph from the shared arrays, which first-touch places on its
+// own node (one replica per node). workers post their best partitions to a
+// shared mailbox guarded by a robust process-shared mutex, and restart from
+// the mailbox best with a few swaps every other start. the mailbox has two
+// partition slots and a post fills the inactive one, so a crashed worker only
+// loses its own starts.
+//
+// ==============================================================================
+
+class MultiProcess {
+
+  public:
+
+    // num_workers == 0 -> one worker per NUMA node
+    MultiProcess(const Hypergraph& hypergraph, size_t num_workers, size_t num_starts, int enabled);
+
+    ~MultiProcess();
+
+    MultiProcess(const MultiProcess&) = delete;
+    MultiProcess& operator= (const MultiProcess&) = delete;
+
+    // applied to every Circuit a worker creates (boundary, heap, ...)
+    void set_configure(const std::function<void(Circuit&)>& configure);
+
+    void set_balance_factor(float balance_factor);
+
+    void apply();
+
+    void dump(std::ostream& os);
+
+    size_t get_cut_size() const;
+
+  private:
+
+    // a post copies into the slot that is not active and then flips active,
+    // the only store that publishes it
+    struct Mailbox {
+      pthread_mutex_t mutex;
+      size_t num_posts;
+      std::array<size_t, 2> cut_size;
+      std::array<int, 2> worker;
+      int active;
+    };
+
+    static std::vector<std::vector<int>> _numa_nodes();
+
+    void _share();
+
+    void _work(size_t w, const std::vector<int>& cpus);
+
+    void _post(size_t w, const Circuit& circuit);
+
+    bool _fetch(std::vector<Partition>& pars);
+
+    const Hypergraph& _hg;
+    size_t _num_workers;
+    size_t _num_starts;
+    int _enabled;
+    float _balance_factor;
+
+    std::function<void(Circuit&)> _configure;
+
+    // shared mapping: mailbox, two partition slots, then the netlist arrays
+    void* _shared{MAP_FAILED};
+    size_t _shared_size{0};
+    Mailbox* _mailbox{nullptr};
+    std::array<uint8_t*, 2> _best{nullptr, nullptr};
+    size_t* _pin_offsets{nullptr};
+    size_t* _pin_ids{nullptr};
+    int* _net_weights{nullptr};
+    double* _cell_areas{nullptr};
+
+    size_t _num_failed{0};
+};
+
+// ==============================================================================
+//
+// Definition of class MultiProcess
+//
+// ==============================================================================
+
+inline
+MultiProcess::MultiProcess(const Hypergraph& hypergraph, size_t num_workers, size_t num_starts, int enabled):
+  _hg{hypergraph},
+  _num_workers{num_workers},
+  _num_starts{std::max<size_t>(num_starts, 1)},
+  _enabled{enabled},
+  _balance_factor{hypergraph.get_balance_factor()} {
+
+  if(_num_workers == 0) {
+    _num_workers = _numa_nodes().size();
+  }
+  _share();
+}
+
+inline
+MultiProcess::~MultiProcess() {
+  if(_shared != MAP_FAILED) {
+    pthread_mutex_destroy(&_mailbox->mutex);
+    munmap(_shared, _shared_size);
+  }
+}
+
+inline
+void MultiProcess::set_configure(const std::function<void(Circuit&)>& configure) {
+  _configure = configure;
+}
+
+inline
+void MultiProcess::set_balance_factor(float balance_factor) {
+  _balance_factor = balance_factor;
+}
+
+inline
+size_t MultiProcess::get_cut_size() const {
+  return _mailbox->active < 0 ? SIZE_MAX : _mailbox->cut_size[_mailbox->active];
+}
+
+// CPUs of every NUMA node from sysfs, one node with every CPU if unavailable
+inline
+std::vector<std::vector<int>> MultiProcess::_numa_nodes() {
+  std::vector<std::vector<int>> nodes;
+
+  for(int n = 0; ; ++n) {
+    std::ifstream ifs{"/sys/devices/system/node/node" + std::to_string(n) + "/cpulist"};
+    if(!ifs) {
+      break;
+    }
+
+    // e.g., 0-15,32-47
+    std::vector<int> cpus;
+    std::string range;
+    while(std::getline(ifs, range, ',')) {
+      auto dash = range.find('-');
+      int first = std::stoi(range.substr(0, dash));
+      int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      for(int c = first; c <= last; ++c) {
+        cpus.push_back(c);
+      }
+    }
+    if(!cpus.empty()) {
+      nodes.push_back(std::move(cpus));
+    }
+  }
+
+  if(nodes.empty()) {
+    nodes.emplace_back();
+    for(long c = 0; c < sysconf(_SC_NPROCESSORS_ONLN); ++c) {
+      nodes.back().push_back(c);
+    }
+  }
+
+  return nodes;
+}
+
+inline
+void MultiProcess::_share() {
+  auto& nets = _hg.get_nets();
+  auto& cells = _hg.get_cells();
+
+  size_t num_pins{0};
+  for(auto* n: nets) {
+    num_pins += n->get_cells().size();
+  }
+
+  auto align = [](size_t size) { return (size + 63) / 64 * 64; };
+  size_t mailbox_size = align(sizeof(Mailbox));
+  size_t best_size = align(cells.size());
+  size_t offsets_size = align((nets.size() + 1) * sizeof(size_t));
+  size_t pins_size = align(num_pins * sizeof(size_t));
+  size_t weights_size = align(nets.size() * sizeof(int));
+  size_t areas_size = align(cells.size() * sizeof(double));
+  _shared_size = mailbox_size + 2 * best_size + offsets_size + pins_size + weights_size + areas_size;
+
+  _shared = mmap(nullptr, _shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if(_shared == MAP_FAILED) {
+    throw std::runtime_error("cannot map shared memory: " + std::string(std::strerror(errno)));
+  }
+
+  char* base = static_cast<char*>(_shared);
+  _mailbox = reinterpret_cast<Mailbox*>(base);
+  _best[0] = reinterpret_cast<uint8_t*>(base + mailbox_size);
+  _best[1] = reinterpret_cast<uint8_t*>(base + mailbox_size + best_size);
+  base += mailbox_size + 2 * best_size;
+  _pin_offsets = reinterpret_cast<size_t*>(base);
+  _pin_ids = reinterpret_cast<size_t*>(base + offsets_size);
+  _net_weights = reinterpret_cast<int*>(base + offsets_size + pins_size);
+  _cell_areas = reinterpret_cast<double*>(base + offsets_size + pins_size + weights_size);
+
+  // a worker dying with the lock held must not block the others
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+  pthread_mutex_init(&_mailbox->mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+
+  _mailbox->num_posts = 0;
+  _mailbox->cut_size = {SIZE_MAX, SIZE_MAX};
+  _mailbox->worker = {-1, -1};
+  _mailbox->active = -1;
+
+  size_t pos{0};
+  for(auto* n: nets) {
+    _pin_offsets[n->get_id()] = pos;
+    _net_weights[n->get_id()] = n->get_weight();
+    for(auto* c: n->get_cells()) {
+      _pin_ids[pos++] = c->get_id();
+    }
+  }
+  _pin_offsets[nets.size()] = pos;
+
+  for(auto* c: cells) {
+    _cell_areas[c->get_id()] = c->get_area();
+  }
+}
+
+inline
+void MultiProcess::apply() {
+
+  auto nodes = _numa_nodes();
+
+  std::cout << "Multi-process F-M: " << _num_workers << " workers, "
+            << _num_starts << " starts each, " << nodes.size() << " NUMA nodes\n";
+
+  std::vector<pid_t> pids;
+  for(size_t w = 0; w < _num_workers; ++w) {
+    pid_t pid = fork();
+    if(pid < 0) {
+      throw std::runtime_error("cannot fork worker: " + std::string(std::strerror(errno)));
+    }
+    if(pid == 0) {
+      // workers sharing a node split its CPUs instead of oversubscribing them
+      auto& node = nodes[w % nodes.size()];
+      size_t num_sharing = (_num_workers - w % nodes.size() + nodes.size() - 1) / nodes.size();
+      size_t rank = w / nodes.size();
+      size_t first = rank * node.size() / num_sharing;
+      size_t last = std::max((rank + 1) * node.size() / num_sharing, first + 1);
+      std::vector<int> cpus(node.begin() + first, node.begin() + last);
+
+      int status{0};
+      try {
+        _work(w, cpus);
+      }
+      catch(const std::exception& e) {
+        std::cerr << "worker " << w << ": " << e.what() << "\n";
+        status = 1;
+      }
+      _exit(status);
+    }
+    pids.push_back(pid);
+  }
+
+  for(size_t w = 0; w < pids.size(); ++w) {
+    int status;
+    waitpid(pids[w], &status, 0);
+    if(WIFSIGNALED(status)) {
+      std::cerr << "worker " << w << " killed by signal " << WTERMSIG(status) << "\n";
+      ++_num_failed;
+    }
+    else if(WEXITSTATUS(status) != 0) {
+      std::cerr << "worker " << w << " failed\n";
+      ++_num_failed;
+    }
+  }
+
+  int active = _mailbox->active;
+  if(active < 0) {
+    throw std::runtime_error("no worker produced a partition");
+  }
+
+  std::cout << "Best cut size: " << _mailbox->cut_size[active] << " (worker " << _mailbox->worker[active]
+            << ", " << _mailbox->num_posts << " posts, " << _num_failed << " failed workers)\n";
+}
+
+inline
+void MultiProcess::_work(size_t w, const std::vector<int>& cpus) {
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for(auto c: cpus) {
+    CPU_SET(c, &set);
+  }
+  sched_setaffinity(0, sizeof(set), &set);
+  omp_set_num_threads(cpus.size());
+
+  // private replica, first touched on this node
+  size_t num_nets = _hg.get_nets().size();
+  size_t num_cells = _hg.get_cells().size();
+  std::vector<size_t> pin_offsets(_pin_offsets, _pin_offsets + num_nets + 1);
+  std::vector<size_t> pin_ids(_pin_ids, _pin_ids + pin_offsets.back());
+  std::vector<int> net_weights;
+  std::vector<double> cell_areas;
+  if(_hg.is_weighted()) {
+    net_weights.assign(_net_weights, _net_weights + num_nets);
+    cell_areas.assign(_cell_areas, _cell_areas + num_cells);
+  }
+  Hypergraph hypergraph(num_cells, pin_offsets, pin_ids, net_weights, cell_areas, _balance_factor);
+
+  std::mt19937 eng(std::random_device{}() + w);
+  std::vector<Partition> start;
+
+  for(size_t s = 0; s < _num_starts; ++s) {
+    Circuit circuit(hypergraph, _enabled);
+    circuit.set_verbose(false);
+    if(_configure) {
+      _configure(circuit);
+    }
+
+    // every other start perturbs the best partition posted so far,
+    // swaps keep the cell counts so only unit areas are perturbed
+    if(s % 2 == 1 && !_hg.is_weighted() && _fetch(start)) {
+      std::array<std::vector<size_t>, 2> sides;
+      for(size_t c = 0; c < num_cells; ++c) {
+        sides[start[c]].push_back(c);
+      }
+      size_t num_swaps = std::min(sides[0].size(), sides[1].size()) / 20;
+      for(size_t k = 0; k < num_swaps; ++k) {
+        std::uniform_int_distribution<size_t> da(0, sides[0].size() - 1);
+        std::uniform_int_distribution<size_t> db(0, sides[1].size() - 1);
+        std::swap(start[sides[0][da(eng)]], start[sides[1][db(eng)]]);
+      }
+      circuit.set_initial_partition([&start](const Cell& cell) {
+        return start[cell.get_id()];
+      });
+    }
+
+    circuit.fm();
+    _post(w, circuit);
+  }
+}
+
+inline
+void MultiProcess::_post(size_t w, const Circuit& circuit) {
+  if(pthread_mutex_lock(&_mailbox->mutex) == EOWNERDEAD) {
+    pthread_mutex_consistent(&_mailbox->mutex);
+  }
+
+  int active = _mailbox->active;
+  if(active < 0 || circuit.get_cut_size() < _mailbox->cut_size[active]) {
+    // a crash before active flips leaves the posted best untouched
+    int slot = active < 0 ? 0 : 1 - active;
+    auto& pars = circuit.get_partition();
+    std::copy(pars.begin(), pars.end(), _best[slot]);
+    _mailbox->cut_size[slot] = circuit.get_cut_size();
+    _mailbox->worker[slot] = w;
+    std::atomic_signal_fence(std::memory_order_release);
+    _mailbox->active = slot;
+  }
+  ++_mailbox->num_posts;
+
+  pthread_mutex_unlock(&_mailbox->mutex);
+}
+
+inline
+bool MultiProcess::_fetch(std::vector<Partition>& pars) {
+  if(pthread_mutex_lock(&_mailbox->mutex) == EOWNERDEAD) {
+    pthread_mutex_consistent(&_mailbox->mutex);
+  }
+
+  int active = _mailbox->active;
+  if(active >= 0) {
+    pars.resize(_hg.get_cells().size());
+    for(size_t c = 0; c < pars.size(); ++c) {
+      pars[c] = static_cast<Partition>(_best[active][c]);
+    }
+  }
+
+  pthread_mutex_unlock(&_mailbox->mutex);
+  return active >= 0;
+}
+
+inline
+void MultiProcess::dump(std::ostream& os) {
+
+  int active = _mailbox->active;
+  const uint8_t* best = _best[active];
+
+  std::array<size_t, 2> num_cells{0, 0};
+  for(size_t c = 0; c < _hg.get_cells().size(); ++c) {
+    ++num_cells[best[c]];
+  }
+
+  os << "Cutsize = " << _mailbox->cut_size[active] << "\n";
+
+  for(int p = 0; p < 2; ++p) {
+    os << "G" << p + 1 << " " << num_cells[p] << "\n";
+    for(auto* c: _hg.get_cells()) {
+      if(best[c->get_id()] == p) {
+        os << c->get_name() << " ";
+      }
+    }
+    os << ";\n";
+  }
+}
+
+} // end of namespace fm =============================================================
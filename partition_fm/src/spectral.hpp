@@ -0,0 +1,382 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <omp.h>
+
+#include "hypergraph.hpp"
+
+namespace fm { // begin of namespace fm =======================================================================
+
+// ==============================================================================
+//
+// Declaration of class Spectral
+//
+// spectral initial partition. the hypergraph is expanded into a sparse graph
+// (clique expansion for small nets, star expansion with one auxiliary vertex for
+// large nets), the Fiedler vector of its Laplacian is computed by restarted
+// Lanczos with OpenMP SpMV, and cells are split at the area-weighted median.
+//
+// ==============================================================================
+
+class Spectral {
+
+  public:
+
+    Spectral(const Hypergraph& hypergraph, size_t max_clique_size = 32);
+
+    void apply();
+
+    // 0 -> partition a, 1 -> partition b, indexed by cell id
+    const std::vector<int>& get_partition() const;
+
+    double get_eigenvalue() const;
+
+  private:
+
+    void _build_graph();
+
+    void _spmv(const std::vector<double>& x, std::vector<double>& y) const;
+
+    double _dot(const std::vector<double>& x, const std::vector<double>& y) const;
+
+    void _orthogonalize(std::vector<double>& x) const;
+
+    void _lanczos();
+
+    void _tqli(std::vector<double>& d, std::vector<double>& e, std::vector<std::vector<double>>& z) const;
+
+    void _split();
+
+    const Hypergraph& _hg;
+    size_t _max_clique_size;
+
+    // Laplacian in CSR, vertices [0, #cells) are cells, the rest are stars
+    size_t _num_vertices{0};
+    std::vector<size_t> _offsets;
+    std::vector<size_t> _adjncy;
+    std::vector<double> _adjwgt;
+    std::vector<double> _degrees;
+
+    std::vector<double> _fiedler;
+    double _eigenvalue{0};
+    std::vector<int> _pars;
+
+    size_t _num_steps{40};
+    size_t _num_restarts{10};
+    double _tolerance{1e-4};
+};
+
+// ==============================================================================
+//
+// Definition of class Spectral
+//
+// ==============================================================================
+
+inline
+Spectral::Spectral(const Hypergraph& hypergraph, size_t max_clique_size):
+  _hg{hypergraph}, _max_clique_size{max_clique_size} {
+}
+
+inline
+const std::vector<int>& Spectral::get_partition() const {
+  return _pars;
+}
+
+inline
+double Spectral::get_eigenvalue() const {
+  return _eigenvalue;
+}
+
+inline
+void Spectral::apply() {
+  _build_graph();
+  _lanczos();
+  _split();
+}
+
+inline
+void Spectral::_build_graph() {
+
+  size_t num_cells = _hg.get_cells().size();
+  _num_vertices = num_cells;
+  for(auto* n: _hg.get_nets()) {
+    if(n->get_cells().size() > _max_clique_size) {
+      ++_num_vertices;
+    }
+  }
+
+  // edges as (u, v, w) in both directions, then merged by sorting
+  std::vector<std::pair<std::pair<size_t, size_t>, double>> edges;
+  size_t star = num_cells;
+
+  for(auto* n: _hg.get_nets()) {
+    auto& cells = n->get_cells();
+    if(cells.size() < 2) {
+      continue;
+    }
+
+    if(cells.size() > _max_clique_size) {
+      double w = n->get_weight() * 2.0 / cells.size();
+      for(auto* c: cells) {
+        edges.push_back({{c->get_id(), star}, w});
+        edges.push_back({{star, c->get_id()}, w});
+      }
+      ++star;
+    }
+    else {
+      double w = static_cast<double>(n->get_weight()) / (cells.size() - 1);
+      for(size_t i = 0; i < cells.size(); ++i) {
+        for(size_t j = i + 1; j < cells.size(); ++j) {
+          if(cells[i] != cells[j]) {
+            edges.push_back({{cells[i]->get_id(), cells[j]->get_id()}, w});
+            edges.push_back({{cells[j]->get_id(), cells[i]->get_id()}, w});
+          }
+        }
+      }
+    }
+  }
+
+  std::sort(edges.begin(), edges.end(), [](const auto& a, const auto& b) {
+    return a.first < b.first;
+  });
+
+  _offsets.assign(_num_vertices + 1, 0);
+  _adjncy.clear();
+  _adjwgt.clear();
+  _degrees.assign(_num_vertices, 0);
+
+  for(size_t i = 0; i < edges.size(); ++i) {
+    auto [u, v] = edges[i].first;
+    _degrees[u] += edges[i].second;
+    if(i > 0 && edges[i - 1].first == edges[i].first) {
+      _adjwgt.back() += edges[i].second;
+      continue;
+    }
+    _adjncy.push_back(v);
+    _adjwgt.push_back(edges[i].second);
+    ++_offsets[u + 1];
+  }
+
+  std::partial_sum(_offsets.begin(), _offsets.end(), _offsets.begin());
+}
+
+// y = L x = D x - A x
+inline
+void Spectral::_spmv(const std::vector<double>& x, std::vector<double>& y) const {
+  #pragma omp parallel for schedule(static)
+  for(size_t u = 0; u < _num_vertices; ++u) {
+    double sum = _degrees[u] * x[u];
+    for(size_t e = _offsets[u]; e < _offsets[u + 1]; ++e) {
+      sum -= _adjwgt[e] * x[_adjncy[e]];
+    }
+    y[u] = sum;
+  }
+}
+
+inline
+double Spectral::_dot(const std::vector<double>& x, const std::vector<double>& y) const {
+  double sum{0};
+  #pragma omp parallel for reduction(+:sum) schedule(static)
+  for(size_t i = 0; i < x.size(); ++i) {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+
+// project out the constant vector (the trivial eigenvector)
+inline
+void Spectral::_orthogonalize(std::vector<double>& x) const {
+  double mean = std::accumulate(x.begin(), x.end(), 0.0) / x.size();
+  for(auto& v: x) {
+    v -= mean;
+  }
+}
+
+// restarted Lanczos with full reorthogonalization for the smallest
+// non-trivial eigenpair of the Laplacian
+inline
+void Spectral::_lanczos() {
+
+  size_t n = _num_vertices;
+  size_t m = std::min(_num_steps, n > 1 ? n - 1 : 1);
+
+  std::random_device rd{};
+  std::mt19937 eng(rd());
+  std::uniform_real_distribution<double> distr(-1, 1);
+
+  _fiedler.resize(n);
+  for(auto& v: _fiedler) {
+    v = distr(eng);
+  }
+
+  std::vector<std::vector<double>> q(m + 1, std::vector<double>(n));
+  std::vector<double> w(n);
+
+  for(size_t r = 0; r < _num_restarts; ++r) {
+
+    _orthogonalize(_fiedler);
+    double norm = std::sqrt(_dot(_fiedler, _fiedler));
+    if(norm == 0) {
+      break;
+    }
+    for(size_t i = 0; i < n; ++i) {
+      q[0][i] = _fiedler[i] / norm;
+    }
+
+    std::vector<double> alpha;
+    std::vector<double> beta;
+
+    for(size_t j = 0; j < m; ++j) {
+      _spmv(q[j], w);
+      alpha.push_back(_dot(q[j], w));
+
+      // full reorthogonalization against the whole basis
+      for(size_t k = 0; k <= j; ++k) {
+        double h = _dot(q[k], w);
+        #pragma omp parallel for schedule(static)
+        for(size_t i = 0; i < n; ++i) {
+          w[i] -= h * q[k][i];
+        }
+      }
+      _orthogonalize(w);
+
+      double b = std::sqrt(_dot(w, w));
+      if(b < 1e-12 || j + 1 == m) {
+        break;
+      }
+      beta.push_back(b);
+      #pragma omp parallel for schedule(static)
+      for(size_t i = 0; i < n; ++i) {
+        q[j + 1][i] = w[i] / b;
+      }
+    }
+
+    // eigenpairs of the tridiagonal matrix
+    size_t k = alpha.size();
+    std::vector<double> d = alpha;
+    std::vector<double> e(k, 0);
+    std::copy(beta.begin(), beta.end(), e.begin());
+    std::vector<std::vector<double>> z(k, std::vector<double>(k, 0));
+    for(size_t i = 0; i < k; ++i) {
+      z[i][i] = 1;
+    }
+    _tqli(d, e, z);
+
+    size_t s = std::min_element(d.begin(), d.end()) - d.begin();
+    double prev_eigenvalue = _eigenvalue;
+    _eigenvalue = d[s];
+
+    // Ritz vector is the start vector of the next restart
+    std::fill(_fiedler.begin(), _fiedler.end(), 0);
+    for(size_t j = 0; j < k; ++j) {
+      #pragma omp parallel for schedule(static)
+      for(size_t i = 0; i < n; ++i) {
+        _fiedler[i] += z[j][s] * q[j][i];
+      }
+    }
+
+    // residual || L y - theta y ||
+    _spmv(_fiedler, w);
+    double residual{0};
+    for(size_t i = 0; i < n; ++i) {
+      residual += (w[i] - _eigenvalue * _fiedler[i]) * (w[i] - _eigenvalue * _fiedler[i]);
+    }
+    // only the order of the Fiedler entries matters for the split,
+    // so a stagnating Ritz value is good enough
+    if(
+      std::sqrt(residual) < _tolerance * std::max(1.0, std::abs(_eigenvalue)) ||
+      (r > 0 && prev_eigenvalue - _eigenvalue < _tolerance * std::abs(_eigenvalue))
+    ) {
+      break;
+    }
+  }
+}
+
+// implicit QL on a symmetric tridiagonal matrix (diagonal d, off-diagonal e),
+// eigenvectors are accumulated in the columns of z
+inline
+void Spectral::_tqli(std::vector<double>& d, std::vector<double>& e, std::vector<std::vector<double>>& z) const {
+  int n = d.size();
+
+  for(int l = 0; l < n; ++l) {
+    int iter{0};
+    int m;
+    do {
+      for(m = l; m < n - 1; ++m) {
+        double dd = std::abs(d[m]) + std::abs(d[m + 1]);
+        if(std::abs(e[m]) <= std::numeric_limits<double>::epsilon() * dd) {
+          break;
+        }
+      }
+
+      if(m != l) {
+        if(iter++ == 60) {
+          break;
+        }
+        double g = (d[l + 1] - d[l]) / (2.0 * e[l]);
+        double r = std::hypot(g, 1.0);
+        g = d[m] - d[l] + e[l] / (g + std::copysign(r, g));
+        double s{1};
+        double c{1};
+        double p{0};
+        int i;
+        for(i = m - 1; i >= l; --i) {
+          double f = s * e[i];
+          double b = c * e[i];
+          e[i + 1] = (r = std::hypot(f, g));
+          if(r == 0) {
+            d[i + 1] -= p;
+            e[m] = 0;
+            break;
+          }
+          s = f / r;
+          c = g / r;
+          g = d[i + 1] - p;
+          r = (d[i] - g) * s + 2.0 * c * b;
+          d[i + 1] = g + (p = s * r);
+          g = c * r - b;
+          for(int k = 0; k < n; ++k) {
+            f = z[k][i + 1];
+            z[k][i + 1] = s * z[k][i] + c * f;
+            z[k][i] = c * z[k][i] - s * f;
+          }
+        }
+        if(r == 0 && i >= l) {
+          continue;
+        }
+        d[l] -= p;
+        e[l] = g;
+        e[m] = 0;
+      }
+    } while(m != l);
+  }
+}
+
+// cells sorted by Fiedler value, partition a takes the prefix up to half of the area
+inline
+void Spectral::_split() {
+  auto& cells = _hg.get_cells();
+
+  std::vector<size_t> order(cells.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+    return _fiedler[a] < _fiedler[b];
+  });
+
+  _pars.assign(cells.size(), 1);
+  double half = _hg.get_total_area() / 2;
+  double area{0};
+  for(auto id: order) {
+    if(area + cells[id]->get_area() / 2 > half) {
+      break;
+    }
+    area += cells[id]->get_area();
+    _pars[id] = 0;
+  }
+}
+
+} // end of namespace fm =============================================================
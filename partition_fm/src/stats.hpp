@@ -0,0 +1,360 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <list>
+#include <unordered_map>
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <fstream>
+
+#include <algorithm>
+
+#include "hypergraph.hpp"
+
+namespace fm { // begin of namespace fm =======================================================================
+
+// ==============================================================================
+//
+// Declaration of class Stats
+//
+// one streaming pass over a .dat file that reports what drives the cost of
+// F-M without building the Cell/Net graph: degree histograms, the maximum gain
+// (size of the bucket array), duplicate nets, connected components and the
+// memory the internal structures would take. only a name map and a few
+// integers per cell are kept.
+//
+// ==============================================================================
+
+class Stats {
+
+  public:
+
+    Stats(const std::string& input_path);
+
+    void analyze();
+
+    void summary(std::ostream& os) const;
+
+  private:
+
+    // histogram bucket of a degree: 1, 2, 3-4, 5-8, 9-16, ...
+    static size_t _bucket(size_t degree);
+
+    uint32_t _find(uint32_t cell);
+
+    void _add_net(std::vector<uint32_t>& pins);
+
+    std::string _input_path;
+    float _balance_factor{0};
+
+    std::unordered_map<std::string, uint32_t> _ids;
+    size_t _name_bytes{0};
+
+    // per cell: pin count (nets incl. repeats), union-find parent and the last
+    // net seen, for the stream-vbyte size of the cell's net list
+    std::vector<uint32_t> _degrees;
+    std::vector<uint32_t> _parents;
+    std::vector<uint32_t> _last_nets;
+
+    // 64-bit hash of the sorted pin set of every net seen so far
+    std::unordered_map<uint64_t, uint32_t> _net_hashes;
+
+    size_t _num_nets{0};
+    size_t _num_pins{0};
+    size_t _num_repeated_pins{0};
+    size_t _num_empty_nets{0};
+    size_t _num_duplicate_nets{0};
+    size_t _max_net_degree{0};
+    size_t _net_name_bytes{0};
+    size_t _compressed_bytes{0};
+
+    std::vector<size_t> _net_histogram;
+    std::vector<size_t> _cell_histogram;
+    size_t _max_cell_degree{0};
+    size_t _num_components{0};
+    size_t _largest_component{0};
+    size_t _num_isolated{0};
+};
+
+// ==============================================================================
+//
+// Definition of class Stats
+//
+// ==============================================================================
+
+inline
+Stats::Stats(const std::string& input_path): _input_path{input_path} {
+}
+
+inline
+size_t Stats::_bucket(size_t degree) {
+  size_t b{0};
+  while((size_t{1} << b) < degree) {
+    ++b;
+  }
+  return b;
+}
+
+inline
+uint32_t Stats::_find(uint32_t cell) {
+  while(_parents[cell] != cell) {
+    _parents[cell] = _parents[_parents[cell]];
+    cell = _parents[cell];
+  }
+  return cell;
+}
+
+inline
+void Stats::analyze() {
+  using namespace std::literals::string_literals;
+
+  std::ifstream ifs{_input_path};
+  if(!ifs) {
+    throw std::runtime_error("cannot open the file"s + _input_path);
+  }
+
+  std::string line;
+
+  // first line is balance factor
+  std::getline(ifs, line);
+  _balance_factor = std::stof(line);
+
+  std::string key;
+  std::vector<uint32_t> pins;
+
+  // tokens are cut out of the net by hand, a stringstream per net would
+  // dominate the runtime
+  auto is_space = [](char c) { return c == ' ' || c == '\n' || c == '\t' || c == '\r'; };
+
+  while(std::getline(ifs, line, ';')) {
+    pins.clear();
+
+    // NET net_name cell_name ...
+    size_t num_tokens{0};
+    size_t i{0};
+    while(true) {
+      while(i < line.size() && is_space(line[i])) {
+        ++i;
+      }
+      if(i == line.size()) {
+        break;
+      }
+      size_t j = i;
+      while(j < line.size() && !is_space(line[j])) {
+        ++j;
+      }
+
+      if(++num_tokens == 2) {
+        _net_name_bytes += j - i;
+      }
+      else if(num_tokens > 2) {
+        key.assign(line, i, j - i);
+        auto iter = _ids.find(key);
+        if(iter == _ids.end()) {
+          if(_ids.size() >= UINT32_MAX) {
+            throw std::runtime_error("too many cells for 32-bit ids");
+          }
+          iter = _ids.emplace(key, _ids.size()).first;
+          _name_bytes += key.size();
+          _degrees.push_back(0);
+          _parents.push_back(iter->second);
+          _last_nets.push_back(UINT32_MAX);
+        }
+        pins.push_back(iter->second);
+      }
+      i = j;
+    }
+
+    if(num_tokens < 2) {
+      continue;
+    }
+
+    _add_net(pins);
+  }
+
+  // histograms and components once all nets are in
+  _cell_histogram.clear();
+  for(uint32_t c = 0; c < _degrees.size(); ++c) {
+    size_t b = _bucket(std::max<uint32_t>(_degrees[c], 1));
+    if(b >= _cell_histogram.size()) {
+      _cell_histogram.resize(b + 1, 0);
+    }
+    ++_cell_histogram[b];
+    _compressed_bytes += (_degrees[c] + 3) / 4;
+    _max_cell_degree = std::max<size_t>(_max_cell_degree, _degrees[c]);
+  }
+
+  std::vector<uint32_t> sizes(_parents.size(), 0);
+  for(uint32_t c = 0; c < _parents.size(); ++c) {
+    ++sizes[_find(c)];
+  }
+  for(uint32_t c = 0; c < _parents.size(); ++c) {
+    if(sizes[c] != 0) {
+      ++_num_components;
+      _largest_component = std::max<size_t>(_largest_component, sizes[c]);
+      _num_isolated += (sizes[c] == 1);
+    }
+  }
+}
+
+inline
+void Stats::_add_net(std::vector<uint32_t>& pins) {
+
+  uint32_t net = _num_nets++;
+  _num_pins += pins.size();
+  _max_net_degree = std::max(_max_net_degree, pins.size());
+
+  size_t b = _bucket(std::max<size_t>(pins.size(), 1));
+  if(b >= _net_histogram.size()) {
+    _net_histogram.resize(b + 1, 0);
+  }
+  ++_net_histogram[b];
+
+  // Hypergraph keeps a repeated pin twice, so degrees count every occurrence
+  for(auto c: pins) {
+    ++_degrees[c];
+  }
+
+  std::sort(pins.begin(), pins.end());
+  size_t size = pins.size();
+  pins.erase(std::unique(pins.begin(), pins.end()), pins.end());
+  _num_repeated_pins += size - pins.size();
+
+  if(pins.empty()) {
+    ++_num_empty_nets;
+    return;
+  }
+
+  // stream-vbyte bytes of the net list (first id, then gaps), and of the
+  // gap appended to the net list of every pin
+  auto vbyte = [](uint32_t v) -> size_t {
+    return v < (1u << 8) ? 1 : v < (1u << 16) ? 2 : v < (1u << 24) ? 3 : 4;
+  };
+  _compressed_bytes += (pins.size() + 3) / 4 + vbyte(pins[0]);
+  for(size_t i = 1; i < pins.size(); ++i) {
+    _compressed_bytes += vbyte(pins[i] - pins[i - 1]);
+  }
+  for(auto c: pins) {
+    _compressed_bytes += vbyte(_last_nets[c] == UINT32_MAX ? net : net - _last_nets[c]);
+    _last_nets[c] = net;
+  }
+
+  uint64_t hash{0xcbf29ce484222325ull};
+  for(auto c: pins) {
+    hash = (hash ^ c) * 0x100000001b3ull;
+    hash ^= hash >> 29;
+  }
+  hash ^= pins.size();
+  if(!_net_hashes.emplace(hash, net).second) {
+    ++_num_duplicate_nets;
+  }
+
+  for(size_t i = 1; i < pins.size(); ++i) {
+    uint32_t a = _find(pins[0]);
+    uint32_t b = _find(pins[i]);
+    if(a != b) {
+      _parents[std::max(a, b)] = std::min(a, b);
+    }
+  }
+}
+
+inline
+void Stats::summary(std::ostream& os) const {
+
+  size_t num_cells = _degrees.size();
+
+  // Hypergraph: objects, adjacency vectors, heap-allocated names (beyond the
+  // small-string buffer) and the two name maps
+  constexpr size_t sso = 15;
+  constexpr size_t map_node = sizeof(std::string) + 2 * sizeof(void*) + sizeof(size_t);
+  size_t graph = num_cells * (sizeof(Cell) + sizeof(Cell*) + map_node + sizeof(void*)) +
+                 _num_nets * (sizeof(Net) + sizeof(Net*) + map_node + sizeof(void*)) +
+                 2 * _num_pins * sizeof(void*);
+  if(_name_bytes > num_cells * sso) {
+    graph += _name_bytes + num_cells;
+  }
+  if(_net_name_bytes > _num_nets * sso) {
+    graph += _net_name_bytes + _num_nets;
+  }
+
+  // Circuit: per-cell and per-net state, bucket nodes and the bucket array
+  size_t max_gain = _max_cell_degree;
+  size_t circuit =
+    num_cells * (sizeof(Partition) + 2 * sizeof(int) + 2 * sizeof(char) +
+                 sizeof(std::list<Cell*>::iterator) + 3 * sizeof(void*) +
+                 sizeof(std::pair<Cell*, int>)) +
+    _num_nets * (sizeof(std::array<size_t, 2>) + sizeof(int) + sizeof(Net*)) +
+    2 * (2 * max_gain + 1) * sizeof(std::list<Cell*>);
+
+  // --compressed: pin lists in both directions with offsets and degrees,
+  // names in one buffer
+  size_t compressed = _compressed_bytes + (num_cells + _num_nets) * (sizeof(uint64_t) + sizeof(uint32_t)) +
+                      _name_bytes + num_cells * sizeof(uint64_t);
+
+  auto mb = [](size_t bytes) { return bytes / 1048576.0; };
+
+  os << std::fixed << std::setprecision(2)
+     << "Balance factor: "        << _balance_factor << "\n"
+     << "Number of cells: "       << num_cells << "\n"
+     << "Number of nets: "        << _num_nets << "\n"
+     << "Number of pins: "        << _num_pins << "\n"
+     << "Average net degree: "    << (_num_nets ? static_cast<double>(_num_pins) / _num_nets : 0) << "\n"
+     << "Average cell degree: "   << (num_cells ? static_cast<double>(_num_pins) / num_cells : 0) << "\n"
+     << "Maximum net degree: "    << _max_net_degree << "\n"
+     << "Maximum cell degree: "   << _max_cell_degree << "\n"
+     << "Maximum available gain: " << max_gain << "\n"
+     << "Repeated pins: "         << _num_repeated_pins << "\n"
+     << "Empty nets: "            << _num_empty_nets << "\n"
+     << "Duplicate nets: "        << _num_duplicate_nets << "\n"
+     << "Connected components: "  << _num_components
+     << " (largest " << _largest_component << ", isolated " << _num_isolated << ")\n";
+
+  auto histogram = [&os](const char* title, const std::vector<size_t>& counts) {
+    os << title << "\n";
+    for(size_t b = 0; b < counts.size(); ++b) {
+      size_t lo = b == 0 ? 1 : (size_t{1} << (b - 1)) + 1;
+      size_t hi = size_t{1} << b;
+      std::string range = lo == hi ? std::to_string(lo) : std::to_string(lo) + "-" + std::to_string(hi);
+      os << "  " << std::setw(14) << std::left << range
+         << std::setw(12) << std::right << counts[b] << "\n";
+    }
+  };
+  histogram("Net degree histogram:", _net_histogram);
+  histogram("Cell degree histogram:", _cell_histogram);
+
+  os << "Estimated memory:\n"
+     << "  hypergraph  " << std::setw(10) << mb(graph) << " MB\n"
+     << "  circuit     " << std::setw(10) << mb(circuit) << " MB\n"
+     << "  compressed  " << std::setw(10) << mb(compressed) << " MB (--compressed)\n";
+
+  // rules of thumb for the performance modes
+  std::vector<std::string> hints;
+  if(max_gain > 1000) {
+    hints.push_back("bucket array has " + std::to_string(2 * max_gain + 1) + " lists per side, consider --heap");
+  }
+  if(_num_pins > num_cells * 8) {
+    hints.push_back("dense netlist, gain updates dominate, consider --boundary");
+  }
+  if(_max_net_degree > 32) {
+    hints.push_back("nets above 32 pins use the star model in --spectral");
+  }
+  if(_num_components > 1) {
+    hints.push_back(std::to_string(_num_components) + " components, F-M cannot gain across them");
+  }
+  if(_num_duplicate_nets > _num_nets / 20) {
+    hints.push_back("many duplicate nets, merging them into weighted nets (--net-weights) shrinks the input");
+  }
+  if(graph + circuit > 4 * compressed && graph + circuit > (size_t{1} << 30)) {
+    hints.push_back("graph exceeds 1 GB, consider --compressed or --stream");
+  }
+  os << "Hints:" << (hints.empty() ? " none" : "") << "\n";
+  for(auto& hint: hints) {
+    os << "  " << hint << "\n";
+  }
+  os << std::defaultfloat;
+}
+
+} // end of namespace fm =============================================================
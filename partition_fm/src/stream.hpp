@@ -0,0 +1,285 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cmath>
+
+#include <algorithm>
+
+namespace fm { // begin of namespace fm =======================================================================
+
+// ==============================================================================
+//
+// Declaration of class StreamPartitioner
+//
+// one-pass k-way partitioner for netlists that do not fit in memory as a
+// Cell/Net graph. nets are read one at a time and every new cell of a net is
+// assigned immediately with LDG scoring (number of already-assigned pins of the
+// net in a partition, damped by how full the partition is). only the per-cell
+// assignment array is kept.
+//
+// ==============================================================================
+
+class StreamPartitioner {
+
+  public:
+
+    StreamPartitioner(const std::string& input_path, size_t num_partitions = 2);
+
+    void partition();
+
+    void dump(std::ostream& os);
+
+    // -1 if the cell has not been seen
+    int get_partition(const std::string& name) const;
+
+    size_t get_cut_size() const;
+
+  private:
+
+    void _assign(const std::vector<std::string>& names);
+
+    int8_t& _slot(const std::string& name);
+
+    bool _split(const std::string& name, size_t& id) const;
+
+    size_t _capacity(size_t num_assigned) const;
+
+    std::string _input_path;
+    size_t _num_partitions;
+    float _balance_factor;
+
+    // cells named <prefix><number> (the common case) are indexed by number
+    // while the number stays near the count of cells, everything else falls
+    // back to a hash map
+    std::string _prefix;
+    std::vector<int8_t> _parts;
+    std::unordered_map<std::string, int8_t> _named_parts;
+
+    std::vector<size_t> _num_cells_in_partition;
+    size_t _num_cells{0};
+    size_t _num_nets{0};
+    size_t _num_pins{0};
+    size_t _cut_size{0};
+    size_t _connectivity{0};
+};
+
+// ==============================================================================
+//
+// Definition of class StreamPartitioner
+//
+// ==============================================================================
+
+inline
+StreamPartitioner::StreamPartitioner(const std::string& input_path, size_t num_partitions):
+  _input_path{input_path}, _num_partitions{num_partitions}, _num_cells_in_partition(num_partitions, 0) {
+
+  if(_num_partitions < 2 || _num_partitions > 127) {
+    throw std::runtime_error("number of partitions should be in [2, 127]");
+  }
+}
+
+inline
+void StreamPartitioner::partition() {
+  using namespace std::literals::string_literals;
+
+  std::ifstream ifs{_input_path};
+  if(!ifs) {
+    throw std::runtime_error("cannot open the file"s + _input_path);
+  }
+
+  std::string line;
+
+  // first line is balance factor
+  std::getline(ifs, line);
+  _balance_factor = std::stof(line);
+
+  std::vector<std::string> names;
+  std::string token;
+
+  // one net at a time
+  while(std::getline(ifs, line, ';')) {
+    std::stringstream line_stream(line);
+    names.clear();
+
+    // NET net_name cell_name ...
+    line_stream >> token >> token;
+    while(line_stream >> token) {
+      names.push_back(token);
+    }
+
+    if(names.empty()) {
+      continue;
+    }
+
+    ++_num_nets;
+    _num_pins += names.size();
+    _assign(names);
+  }
+}
+
+// a partition may hold at most _capacity(m) of the first m cells, so the final
+// partition satisfies the same strict bound as Circuit::_check
+inline
+size_t StreamPartitioner::_capacity(size_t num_assigned) const {
+  size_t even = (num_assigned + _num_partitions - 1) / _num_partitions;
+  double bound = std::ceil((1 + _balance_factor) * num_assigned / _num_partitions) - 1;
+  return std::max(even, static_cast<size_t>(std::max(bound, 0.0)));
+}
+
+inline
+void StreamPartitioner::_assign(const std::vector<std::string>& names) {
+
+  // pins of this net that are already assigned
+  std::vector<size_t> pins(_num_partitions, 0);
+  std::vector<int8_t*> unassigned;
+
+  // create slots first since growing _parts invalidates references
+  for(auto& name: names) {
+    _slot(name);
+  }
+
+  for(auto& name: names) {
+    int8_t& par = _slot(name);
+    if(par >= 0) {
+      ++pins[par];
+    }
+    else if(std::find(unassigned.begin(), unassigned.end(), &par) == unassigned.end()) {
+      unassigned.push_back(&par);
+    }
+  }
+
+  for(auto* par: unassigned) {
+    size_t cap = _capacity(_num_cells + 1);
+    int best{-1};
+    double best_score{-1};
+
+    for(size_t p = 0; p < _num_partitions; ++p) {
+      if(_num_cells_in_partition[p] + 1 > cap) {
+        continue;
+      }
+
+      double score = pins[p] * (1 - static_cast<double>(_num_cells_in_partition[p]) / cap);
+      if(
+        score > best_score ||
+        (score == best_score && _num_cells_in_partition[p] < _num_cells_in_partition[best])
+      ) {
+        best = p;
+        best_score = score;
+      }
+    }
+
+    *par = best;
+    ++pins[best];
+    ++_num_cells_in_partition[best];
+    ++_num_cells;
+  }
+
+  // every cell of the net is assigned now and will never move again
+  size_t spanned = std::count_if(pins.begin(), pins.end(), [](size_t n) { return n != 0; });
+  if(spanned > 1) {
+    ++_cut_size;
+    _connectivity += spanned - 1;
+  }
+}
+
+inline
+bool StreamPartitioner::_split(const std::string& name, size_t& id) const {
+  size_t pos = name.find_first_of("0123456789");
+  if(
+    pos == std::string::npos || pos != _prefix.size() ||
+    name.compare(0, pos, _prefix) != 0 ||
+    name.find_first_not_of("0123456789", pos) != std::string::npos ||
+    (name[pos] == '0' && name.size() - pos > 1) ||
+    name.size() - pos > 9
+  ) {
+    return false;
+  }
+
+  id = std::stoul(name.substr(pos));
+  return true;
+}
+
+inline
+int8_t& StreamPartitioner::_slot(const std::string& name) {
+  if(_parts.empty() && _named_parts.empty()) {
+    _prefix = name.substr(0, name.find_first_of("0123456789"));
+  }
+
+  // the table only grows to a few times the cells seen so far, so a stray
+  // large number such as c999999999 goes to the map instead of allocating
+  // up to its id. numbered names below the table size never stay in the map
+  size_t id;
+  if(_split(name, id) && id < std::max(_parts.size(), 4 * _num_cells + 1024)) {
+    if(id >= _parts.size()) {
+      _parts.resize(std::max(id + 1, _parts.size() * 2), -1);
+      for(auto iter = _named_parts.begin(); iter != _named_parts.end();) {
+        size_t moved;
+        if(_split(iter->first, moved) && moved < _parts.size()) {
+          _parts[moved] = iter->second;
+          iter = _named_parts.erase(iter);
+        }
+        else {
+          ++iter;
+        }
+      }
+    }
+    return _parts[id];
+  }
+
+  return _named_parts.emplace(name, -1).first->second;
+}
+
+inline
+int StreamPartitioner::get_partition(const std::string& name) const {
+  size_t id;
+  if(_split(name, id) && id < _parts.size()) {
+    return _parts[id];
+  }
+
+  auto iter = _named_parts.find(name);
+  return iter == _named_parts.end() ? -1 : iter->second;
+}
+
+inline
+size_t StreamPartitioner::get_cut_size() const {
+  return _cut_size;
+}
+
+inline
+void StreamPartitioner::dump(std::ostream& os) {
+
+  std::cout << "Streaming partition: " << _num_partitions << " partitions\n"
+            << "Number of nets: "      << _num_nets        << "\n"
+            << "Number of cells: "     << _num_cells       << "\n"
+            << "Number of pins: "      << _num_pins        << "\n"
+            << "Cut size: "            << _cut_size        << "\n"
+            << "Connectivity - 1: "    << _connectivity    << "\n";
+
+  os << "Cutsize = " << _cut_size << "\n";
+
+  // one partition at a time so no per-partition name list is kept
+  for(size_t p = 0; p < _num_partitions; ++p) {
+    os << "G" << p + 1 << " " << _num_cells_in_partition[p] << "\n";
+
+    for(size_t id = 0; id < _parts.size(); ++id) {
+      if(_parts[id] == static_cast<int8_t>(p)) {
+        os << _prefix << id << " ";
+      }
+    }
+    for(auto&& s_p: _named_parts) {
+      if(s_p.second == static_cast<int8_t>(p)) {
+        os << s_p.first << " ";
+      }
+    }
+    os << ";\n";
+  }
+}
+
+} // end of namespace fm =============================================================
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <iomanip>
+#include <omp.h>
+
+#include "circuit.hpp"
+
+namespace fm { // begin of namespace fm =======================================================================
+
+// ==============================================================================
+//
+// Declaration of class Sweep
+//
+// runs F-M for several balance factors on one parsed hypergraph.
+// every setting gets its own Circuit, all settings run concurrently and share
+// the read-only hypergraph and the same initial partition.
+//
+// ==============================================================================
+
+class Sweep {
+
+  public:
+
+    Sweep(
+      const Hypergraph& hypergraph,
+      const std::vector<float>& balance_factors,
+      int enabled
+    );
+
+    std::vector<std::unique_ptr<Circuit>>& get_circuits();
+
+    void apply();
+
+    // one output per setting at output_path.<index>
+    void dump(const std::string& output_path);
+
+    // cut vs. balance table
+    void summary(std::ostream& os);
+
+  private:
+
+    const Hypergraph& _hg;
+    std::vector<float> _balance_factors;
+    std::vector<std::unique_ptr<Circuit>> _circuits;
+    std::vector<float> _runtimes;
+    std::vector<Partition> _initial_pars;
+};
+
+// ==============================================================================
+//
+// Definition of class Sweep
+//
+// ==============================================================================
+
+inline
+Sweep::Sweep(
+  const Hypergraph& hypergraph,
+  const std::vector<float>& balance_factors,
+  int enabled
+): _hg{hypergraph}, _balance_factors{balance_factors}, _runtimes(balance_factors.size(), 0) {
+
+  // one random initial partition for all settings
+  std::random_device rd{};
+  std::mt19937 eng(rd());
+  std::uniform_int_distribution<> distr(0, 1);
+  _initial_pars.resize(_hg.get_cells().size());
+  for(auto& par: _initial_pars) {
+    par = static_cast<Partition>(distr(eng));
+  }
+
+  for(auto bf: _balance_factors) {
+    _circuits.emplace_back(std::make_unique<Circuit>(_hg, enabled));
+    _circuits.back()->set_balance_factor(bf);
+    _circuits.back()->set_verbose(false);
+    _circuits.back()->set_initial_partition([this](const Cell& cell) {
+      return _initial_pars[cell.get_id()];
+    });
+  }
+}
+
+inline
+std::vector<std::unique_ptr<Circuit>>& Sweep::get_circuits() {
+  return _circuits;
+}
+
+inline
+void Sweep::apply() {
+
+  std::cout << "Balance factor sweep: " << _balance_factors.size() << " settings, "
+            << omp_get_max_threads() << " threads\n";
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(size_t i = 0; i < _circuits.size(); ++i) {
+    auto tic = std::chrono::steady_clock::now();
+    _circuits[i]->fm();
+    auto toc = std::chrono::steady_clock::now();
+    _runtimes[i] = std::chrono::duration<float>(toc - tic).count();
+  }
+}
+
+inline
+void Sweep::dump(const std::string& output_path) {
+  for(size_t i = 0; i < _circuits.size(); ++i) {
+    std::ofstream ofs{output_path + "." + std::to_string(i)};
+    _circuits[i]->dump(ofs);
+  }
+}
+
+inline
+void Sweep::summary(std::ostream& os) {
+
+  os << "| index | balance factor | cut size | G1 | G2 | area G1 / total | runtime (s) |\n"
+     << "|-------|----------------|----------|----|----|-----------------|-------------|\n";
+
+  for(size_t i = 0; i < _circuits.size(); ++i) {
+    double area_a = _circuits[i]->get_area(Partition::A);
+    double area_b = _circuits[i]->get_area(Partition::B);
+
+    os << "| " << i
+       << " | " << _balance_factors[i]
+       << " | " << _circuits[i]->get_cut_size()
+       << " | " << _circuits[i]->get_num_cells(Partition::A)
+       << " | " << _circuits[i]->get_num_cells(Partition::B)
+       << " | " << std::setprecision(4) << area_a / (area_a + area_b)
+       << " | " << std::setprecision(3) << _runtimes[i]
+       << " |\n" << std::setprecision(6);
+  }
+}
+
+} // end of namespace fm =============================================================
@@ -0,0 +1,536 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <random>
+#include <limits>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+
+#include "circuit.hpp"
+#include "spectral.hpp"
+
+namespace fm { // begin of namespace fm =======================================================================
+
+// ==============================================================================
+//
+// Declaration of struct Features
+//
+// cheap hypergraph features, one pass over the pins. designs with the same
+// signature are considered similar and share a tuned configuration.
+//
+// ==============================================================================
+
+struct Features {
+
+  size_t num_cells{0};
+  size_t num_nets{0};
+  size_t num_pins{0};
+  size_t max_net_degree{0};
+
+  // average pins per net and nets per cell
+  double net_degree{0};
+  double cell_degree{0};
+
+  // fraction of nets with more than 32 pins
+  double large_nets{0};
+
+  // average id span (max - min) of a net over #cells; ids follow the order
+  // of first appearance, so local netlists have small spans
+  double locality{0};
+
+  // e.g., c17-n3-d4-l1-s2: log2 #cells, net degree, cell degree,
+  // large-net bucket, locality decile
+  std::string signature() const;
+};
+
+// ==============================================================================
+//
+// Declaration of struct TuneConfig
+//
+// ==============================================================================
+
+struct TuneConfig {
+
+  // Fiedler vector split instead of a random initial partition, nets larger
+  // than max_clique_size become stars in its graph model
+  bool spectral{false};
+  size_t max_clique_size{32};
+
+  bool boundary{false};
+
+  int max_num_passes{10};
+  float min_improvement{0.05f};
+
+  // independent runs, the best cut is kept
+  size_t num_starts{1};
+
+  // boundary mode and pass schedule (the initial partition is set by the caller)
+  void configure(Circuit& circuit) const;
+
+  // spectral=0 clique=32 boundary=0 passes=10 improvement=0.05 starts=1
+  std::string to_string() const;
+
+  static TuneConfig parse(const std::string& str);
+};
+
+// ==============================================================================
+//
+// Declaration of class Tuner
+//
+// picks a configuration per input. short trials of every candidate run on a
+// BFS sample of the hypergraph, the target cut is within 2% of the best cut
+// of all trials, and the fastest candidate reaching it wins. the choice is
+// saved under the feature signature, so later runs on similar designs skip
+// the trials.
+//
+// ==============================================================================
+
+class Tuner {
+
+  public:
+
+    Tuner(const Hypergraph& hypergraph, int enabled, size_t sample_size = 10000);
+
+    const Features& get_features() const;
+
+    // configuration stored for the signature in path, or the trial winner
+    // (then saved to path)
+    TuneConfig tune(const std::string& path);
+
+    // features and trial table
+    void summary(std::ostream& os) const;
+
+  private:
+
+    struct Trial {
+      TuneConfig config;
+      size_t cut_size;
+      double runtime;
+    };
+
+    void _measure();
+
+    std::unique_ptr<Hypergraph> _sample() const;
+
+    TuneConfig _search(const Hypergraph& sample);
+
+    Trial _trial(
+      const Hypergraph& sample,
+      const TuneConfig& config,
+      const std::vector<int>* init,
+      double init_runtime
+    ) const;
+
+    bool _load(const std::string& path, TuneConfig& config) const;
+
+    void _save(const std::string& path, const TuneConfig& config) const;
+
+    const Hypergraph& _hg;
+    int _enabled;
+    size_t _sample_size;
+
+    Features _features;
+    std::vector<Trial> _trials;
+    size_t _target{0};
+    bool _is_loaded{false};
+};
+
+// ==============================================================================
+//
+// Definition of struct Features
+//
+// ==============================================================================
+
+inline
+std::string Features::signature() const {
+
+  int large{0};
+  if(large_nets >= 0.1) {
+    large = 3;
+  }
+  else if(large_nets >= 0.01) {
+    large = 2;
+  }
+  else if(large_nets >= 0.001) {
+    large = 1;
+  }
+
+  std::ostringstream ss;
+  ss << "c" << std::lround(std::log2(std::max<size_t>(num_cells, 1)))
+     << "-n" << std::lround(net_degree)
+     << "-d" << std::lround(cell_degree)
+     << "-l" << large
+     << "-s" << std::min(static_cast<int>(locality * 10), 9);
+  return ss.str();
+}
+
+// ==============================================================================
+//
+// Definition of struct TuneConfig
+//
+// ==============================================================================
+
+inline
+void TuneConfig::configure(Circuit& circuit) const {
+  circuit.set_boundary(boundary);
+  circuit.set_max_num_passes(max_num_passes);
+  circuit.set_min_improvement(min_improvement);
+}
+
+inline
+std::string TuneConfig::to_string() const {
+  std::ostringstream ss;
+  ss << "spectral=" << spectral
+     << " clique=" << max_clique_size
+     << " boundary=" << boundary
+     << " passes=" << max_num_passes
+     << " improvement=" << min_improvement
+     << " starts=" << num_starts;
+  return ss.str();
+}
+
+inline
+TuneConfig TuneConfig::parse(const std::string& str) {
+  TuneConfig config;
+  std::istringstream ss(str);
+  std::string token;
+  while(ss >> token) {
+    auto eq = token.find('=');
+    if(eq == std::string::npos) {
+      throw std::runtime_error("malformed tuning entry " + token);
+    }
+    std::string key = token.substr(0, eq);
+    std::string value = token.substr(eq + 1);
+    if(key == "spectral") {
+      config.spectral = std::stoi(value) != 0;
+    }
+    else if(key == "clique") {
+      config.max_clique_size = std::stoul(value);
+    }
+    else if(key == "boundary") {
+      config.boundary = std::stoi(value) != 0;
+    }
+    else if(key == "passes") {
+      config.max_num_passes = std::stoi(value);
+    }
+    else if(key == "improvement") {
+      config.min_improvement = std::stof(value);
+    }
+    else if(key == "starts") {
+      config.num_starts = std::max<size_t>(std::stoul(value), 1);
+    }
+    else {
+      throw std::runtime_error("unknown tuning key " + key);
+    }
+  }
+  return config;
+}
+
+// ==============================================================================
+//
+// Definition of class Tuner
+//
+// ==============================================================================
+
+inline
+Tuner::Tuner(const Hypergraph& hypergraph, int enabled, size_t sample_size):
+  _hg{hypergraph}, _enabled{enabled}, _sample_size{std::max<size_t>(sample_size, 1)} {
+  _measure();
+}
+
+inline
+const Features& Tuner::get_features() const {
+  return _features;
+}
+
+inline
+TuneConfig Tuner::tune(const std::string& path) {
+
+  TuneConfig config;
+  if(_load(path, config)) {
+    _is_loaded = true;
+    return config;
+  }
+
+  auto sample = _sample();
+  config = _search(*sample);
+  _save(path, config);
+  return config;
+}
+
+inline
+void Tuner::summary(std::ostream& os) const {
+
+  os << "cells: " << _features.num_cells
+     << ", nets: " << _features.num_nets
+     << ", pins: " << _features.num_pins
+     << ", max net degree: " << _features.max_net_degree << "\n"
+     << "net degree: " << _features.net_degree
+     << ", cell degree: " << _features.cell_degree
+     << ", large nets: " << _features.large_nets
+     << ", locality: " << _features.locality << "\n"
+     << "signature: " << _features.signature()
+     << (_is_loaded ? " (stored configuration)" : "") << "\n";
+
+  if(_trials.empty()) {
+    return;
+  }
+
+  os << "target cut on sample: " << _target << "\n"
+     << std::setw(64) << std::left << "configuration"
+     << std::setw(10) << std::right << "cut"
+     << std::setw(12) << "runtime(s)" << "\n";
+  for(auto& t: _trials) {
+    os << std::setw(64) << std::left << t.config.to_string()
+       << std::setw(10) << std::right << t.cut_size
+       << std::setw(12) << std::fixed << std::setprecision(4) << t.runtime << "\n";
+  }
+  os << std::defaultfloat;
+}
+
+inline
+void Tuner::_measure() {
+
+  auto& cells = _hg.get_cells();
+  auto& nets = _hg.get_nets();
+
+  _features.num_cells = cells.size();
+  _features.num_nets = nets.size();
+
+  size_t num_large{0};
+  double span{0};
+  for(auto* n: nets) {
+    auto& pins = n->get_cells();
+    _features.num_pins += pins.size();
+    _features.max_net_degree = std::max(_features.max_net_degree, pins.size());
+    if(pins.size() > 32) {
+      ++num_large;
+    }
+    if(pins.empty()) {
+      continue;
+    }
+    size_t lo = pins[0]->get_id();
+    size_t hi = lo;
+    for(auto* c: pins) {
+      lo = std::min(lo, c->get_id());
+      hi = std::max(hi, c->get_id());
+    }
+    span += hi - lo;
+  }
+
+  if(!nets.empty()) {
+    _features.net_degree = static_cast<double>(_features.num_pins) / nets.size();
+    _features.large_nets = static_cast<double>(num_large) / nets.size();
+    if(!cells.empty()) {
+      _features.locality = span / nets.size() / cells.size();
+    }
+  }
+  if(!cells.empty()) {
+    _features.cell_degree = static_cast<double>(_features.num_pins) / cells.size();
+  }
+}
+
+// cells reached by BFS from random seeds and the nets with at least two pins
+// among them, so the sample keeps the local structure of the design
+inline
+std::unique_ptr<Hypergraph> Tuner::_sample() const {
+
+  auto& cells = _hg.get_cells();
+  auto& nets = _hg.get_nets();
+  size_t target = std::min(_sample_size, cells.size());
+
+  std::vector<int> locals(cells.size(), -1);
+  std::vector<Cell*> picked;
+  picked.reserve(target);
+
+  std::mt19937 eng{std::random_device{}()};
+  std::uniform_int_distribution<size_t> distr(0, cells.size() - 1);
+
+  size_t head{0};
+  while(picked.size() < target) {
+    if(head == picked.size()) {
+      Cell* seed = cells[distr(eng)];
+      if(locals[seed->get_id()] == -1) {
+        locals[seed->get_id()] = picked.size();
+        picked.push_back(seed);
+      }
+      continue;
+    }
+    for(auto* n: picked[head++]->get_nets()) {
+      for(auto* c: n->get_cells()) {
+        if(locals[c->get_id()] == -1 && picked.size() < target) {
+          locals[c->get_id()] = picked.size();
+          picked.push_back(c);
+        }
+      }
+    }
+  }
+
+  std::vector<size_t> offsets{0};
+  std::vector<size_t> pins;
+  std::vector<int> weights;
+  std::vector<char> is_seen(nets.size(), false);
+  for(auto* c: picked) {
+    for(auto* n: c->get_nets()) {
+      if(is_seen[n->get_id()]) {
+        continue;
+      }
+      is_seen[n->get_id()] = true;
+
+      size_t begin = pins.size();
+      for(auto* p: n->get_cells()) {
+        if(locals[p->get_id()] != -1) {
+          pins.push_back(locals[p->get_id()]);
+        }
+      }
+      if(pins.size() - begin < 2) {
+        pins.resize(begin);
+        continue;
+      }
+      offsets.push_back(pins.size());
+      weights.push_back(n->get_weight());
+    }
+  }
+
+  std::vector<double> areas;
+  if(_hg.is_weighted()) {
+    areas.reserve(picked.size());
+    for(auto* c: picked) {
+      areas.push_back(c->get_area());
+    }
+  }
+  else {
+    weights.clear();
+  }
+
+  return std::make_unique<Hypergraph>(
+    picked.size(), offsets, pins, weights, areas, _hg.get_balance_factor()
+  );
+}
+
+inline
+TuneConfig Tuner::_search(const Hypergraph& sample) {
+
+  const std::vector<std::pair<int, float>> schedules{{4, 0.1f}, {10, 0.05f}, {20, 0.01f}};
+  const std::vector<size_t> clique_sizes{0, 16, 64};
+
+  _trials.clear();
+
+  for(auto clique: clique_sizes) {
+
+    // one spectral split per threshold, its runtime is charged to every trial
+    std::unique_ptr<Spectral> spectral;
+    double init_runtime{0};
+    if(clique != 0) {
+      auto tic = std::chrono::steady_clock::now();
+      spectral = std::make_unique<Spectral>(sample, clique);
+      spectral->apply();
+      auto toc = std::chrono::steady_clock::now();
+      init_runtime = std::chrono::duration<double>(toc - tic).count();
+    }
+
+    for(bool boundary: {false, true}) {
+      for(auto& [passes, improvement]: schedules) {
+        TuneConfig config;
+        config.spectral = clique != 0;
+        config.max_clique_size = clique != 0 ? clique : 32;
+        config.boundary = boundary;
+        config.max_num_passes = passes;
+        config.min_improvement = improvement;
+        _trials.push_back(_trial(
+          sample, config, spectral ? &spectral->get_partition() : nullptr, init_runtime
+        ));
+      }
+    }
+  }
+
+  // a second start only pays off for random initial partitions
+  Trial second{_trials[0]};
+  for(auto& t: _trials) {
+    if(!t.config.spectral && t.runtime < second.runtime) {
+      second = t;
+    }
+  }
+  second.config.num_starts = 2;
+  _trials.push_back(_trial(sample, second.config, nullptr, 0));
+
+  size_t best_cut = _trials[0].cut_size;
+  for(auto& t: _trials) {
+    best_cut = std::min(best_cut, t.cut_size);
+  }
+  _target = best_cut + best_cut / 50;
+
+  const Trial* winner{nullptr};
+  for(auto& t: _trials) {
+    if(t.cut_size <= _target && (winner == nullptr || t.runtime < winner->runtime)) {
+      winner = &t;
+    }
+  }
+  return winner->config;
+}
+
+inline
+Tuner::Trial Tuner::_trial(
+  const Hypergraph& sample,
+  const TuneConfig& config,
+  const std::vector<int>* init,
+  double init_runtime
+) const {
+
+  Trial trial{config, std::numeric_limits<size_t>::max(), init_runtime};
+
+  for(size_t s = 0; s < config.num_starts; ++s) {
+    auto tic = std::chrono::steady_clock::now();
+
+    Circuit circuit(sample, _enabled);
+    circuit.set_verbose(false);
+    config.configure(circuit);
+    if(init != nullptr) {
+      circuit.set_initial_partition([init](const Cell& cell) {
+        return static_cast<Partition>((*init)[cell.get_id()]);
+      });
+    }
+    circuit.fm();
+
+    auto toc = std::chrono::steady_clock::now();
+    trial.runtime += std::chrono::duration<double>(toc - tic).count();
+    trial.cut_size = std::min(trial.cut_size, circuit.get_cut_size());
+  }
+
+  return trial;
+}
+
+// one line per signature: <signature> <configuration>
+inline
+bool Tuner::_load(const std::string& path, TuneConfig& config) const {
+
+  std::ifstream ifs(path);
+  std::string signature = _features.signature();
+  std::string line;
+  while(std::getline(ifs, line)) {
+    std::istringstream ss(line);
+    std::string key;
+    if(ss >> key && key == signature) {
+      std::string rest;
+      std::getline(ss, rest);
+      config = TuneConfig::parse(rest);
+      return true;
+    }
+  }
+  return false;
+}
+
+inline
+void Tuner::_save(const std::string& path, const TuneConfig& config) const {
+  std::ofstream ofs(path, std::ios::app);
+  if(!ofs) {
+    throw std::runtime_error("cannot open tuning file " + path);
+  }
+  ofs << _features.signature() << " " << config.to_string() << "\n";
+}
+
+} // end of namespace fm =============================================================